@@ -391,6 +391,10 @@
 #define __NR_pwritev			(__NR_SYSCALL_BASE+362)
 #define __NR_rt_tgsigqueueinfo		(__NR_SYSCALL_BASE+363)
 #define __NR_perf_event_open		(__NR_SYSCALL_BASE+364)
+#define __NR_recvmmsg			(__NR_SYSCALL_BASE+365)
+#define __NR_accept4			(__NR_SYSCALL_BASE+366)
+					/* 367 - 373 reserved */
+#define __NR_sendmmsg			(__NR_SYSCALL_BASE+374)
 
 /*
  * The following SWIs are ARM private.
@@ -127,6 +127,7 @@ void blk_rq_init(struct request_queue *q, struct request *rq)
 	rq->tag = -1;
 	rq->ref_count = 1;
 	rq->start_time = jiffies;
+	blk_latency_init_rq(rq);
 }
 EXPORT_SYMBOL(blk_rq_init);
 
@@ -1150,18 +1151,99 @@ static inline bool queue_should_plug(struct request_queue *q)
 	return !(blk_queue_nonrot(q) && blk_queue_queuing(q));
 }
 
+static bool bio_attempt_back_merge(struct request_queue *q, struct request *req,
+				   struct bio *bio)
+{
+	const unsigned int ff = bio->bi_rw & REQ_FAILFAST_MASK;
+
+	if (!ll_back_merge_fn(q, req, bio))
+		return false;
+
+	trace_block_bio_backmerge(q, bio);
+
+	if ((req->cmd_flags & REQ_FAILFAST_MASK) != ff)
+		blk_rq_set_mixed_merge(req);
+
+	req->biotail->bi_next = bio;
+	req->biotail = bio;
+	req->__data_len += bio->bi_size;
+	req->ioprio = ioprio_best(req->ioprio, bio_prio(bio));
+	if (!blk_rq_cpu_valid(req))
+		req->cpu = bio->bi_comp_cpu;
+	drive_stat_acct(req, 0);
+	return true;
+}
+
+static bool bio_attempt_front_merge(struct request_queue *q,
+				    struct request *req, struct bio *bio)
+{
+	const unsigned int ff = bio->bi_rw & REQ_FAILFAST_MASK;
+
+	if (!ll_front_merge_fn(q, req, bio))
+		return false;
+
+	trace_block_bio_frontmerge(q, bio);
+
+	if ((req->cmd_flags & REQ_FAILFAST_MASK) != ff) {
+		blk_rq_set_mixed_merge(req);
+		req->cmd_flags &= ~REQ_FAILFAST_MASK;
+		req->cmd_flags |= ff;
+	}
+
+	bio->bi_next = req->bio;
+	req->bio = bio;
+
+	/*
+	 * may not be valid. if the low level driver said
+	 * it didn't need a bounce buffer then it better
+	 * not touch req->buffer either...
+	 */
+	req->buffer = bio_data(bio);
+	req->__sector = bio->bi_sector;
+	req->__data_len += bio->bi_size;
+	req->ioprio = ioprio_best(req->ioprio, bio_prio(bio));
+	if (!blk_rq_cpu_valid(req))
+		req->cpu = bio->bi_comp_cpu;
+	drive_stat_acct(req, 0);
+	return true;
+}
+
+/*
+ * Try to merge @bio into one of the requests on the plug list of the
+ * current task.  The list is private to the task, so no locking needed.
+ */
+static bool attempt_plug_merge(struct request_queue *q, struct bio *bio)
+{
+	struct blk_plug *plug = current->plug;
+	struct request *rq;
+
+	list_for_each_entry_reverse(rq, &plug->list, queuelist) {
+		if (rq->q != q || !elv_rq_merge_ok(rq, bio))
+			continue;
+
+		if (blk_rq_pos(rq) + blk_rq_sectors(rq) == bio->bi_sector) {
+			if (bio_attempt_back_merge(q, rq, bio))
+				return true;
+		} else if (blk_rq_pos(rq) - bio_sectors(bio) == bio->bi_sector) {
+			if (bio_attempt_front_merge(q, rq, bio))
+				return true;
+		}
+	}
+
+	return false;
+}
+
 static int __make_request(struct request_queue *q, struct bio *bio)
 {
+	struct blk_plug *plug;
 	struct request *req;
 	int el_ret;
-	unsigned int bytes = bio->bi_size;
-	const unsigned short prio = bio_prio(bio);
 	const bool sync = bio_rw_flagged(bio, BIO_RW_SYNCIO);
 	const bool unplug = bio_rw_flagged(bio, BIO_RW_UNPLUG);
-	const unsigned int ff = bio->bi_rw & REQ_FAILFAST_MASK;
+	const bool barrier = bio_rw_flagged(bio, BIO_RW_BARRIER);
 	int rw_flags;
 
-	if (bio_rw_flagged(bio, BIO_RW_BARRIER) &&
+	if (barrier &&
 	    (q->next_ordered == QUEUE_ORDERED_NONE)) {
 		bio_endio(bio, -EOPNOTSUPP);
 		return 0;
@@ -1173,9 +1255,23 @@ static int __make_request(struct request_queue *q, struct bio *bio)
 	 */
 	blk_queue_bounce(q, &bio);
 
+	if (unlikely(barrier)) {
+		/* whatever we have plugged must get there first */
+		blk_flush_plug(current);
+		spin_lock_irq(q->queue_lock);
+		goto get_rq;
+	}
+
+	/*
+	 * Check the task's plug list first, it is cheap and does not
+	 * need the queue lock.
+	 */
+	if (current->plug && attempt_plug_merge(q, bio))
+		return 0;
+
 	spin_lock_irq(q->queue_lock);
 
-	if (unlikely(bio_rw_flagged(bio, BIO_RW_BARRIER)) || elv_queue_empty(q))
+	if (elv_queue_empty(q))
 		goto get_rq;
 
 	el_ret = elv_merge(q, &req, bio);
@@ -1183,21 +1279,9 @@ static int __make_request(struct request_queue *q, struct bio *bio)
 	case ELEVATOR_BACK_MERGE:
 		BUG_ON(!rq_mergeable(req));
 
-		if (!ll_back_merge_fn(q, req, bio))
+		if (!bio_attempt_back_merge(q, req, bio))
 			break;
 
-		trace_block_bio_backmerge(q, bio);
-
-		if ((req->cmd_flags & REQ_FAILFAST_MASK) != ff)
-			blk_rq_set_mixed_merge(req);
-
-		req->biotail->bi_next = bio;
-		req->biotail = bio;
-		req->__data_len += bytes;
-		req->ioprio = ioprio_best(req->ioprio, prio);
-		if (!blk_rq_cpu_valid(req))
-			req->cpu = bio->bi_comp_cpu;
-		drive_stat_acct(req, 0);
 		if (!attempt_back_merge(q, req))
 			elv_merged_request(q, req, el_ret);
 		goto out;
@@ -1205,32 +1289,9 @@ static int __make_request(struct request_queue *q, struct bio *bio)
 	case ELEVATOR_FRONT_MERGE:
 		BUG_ON(!rq_mergeable(req));
 
-		if (!ll_front_merge_fn(q, req, bio))
+		if (!bio_attempt_front_merge(q, req, bio))
 			break;
 
-		trace_block_bio_frontmerge(q, bio);
-
-		if ((req->cmd_flags & REQ_FAILFAST_MASK) != ff) {
-			blk_rq_set_mixed_merge(req);
-			req->cmd_flags &= ~REQ_FAILFAST_MASK;
-			req->cmd_flags |= ff;
-		}
-
-		bio->bi_next = req->bio;
-		req->bio = bio;
-
-		/*
-		 * may not be valid. if the low level driver said
-		 * it didn't need a bounce buffer then it better
-		 * not touch req->buffer either...
-		 */
-		req->buffer = bio_data(bio);
-		req->__sector = bio->bi_sector;
-		req->__data_len += bytes;
-		req->ioprio = ioprio_best(req->ioprio, prio);
-		if (!blk_rq_cpu_valid(req))
-			req->cpu = bio->bi_comp_cpu;
-		drive_stat_acct(req, 0);
 		if (!attempt_front_merge(q, req))
 			elv_merged_request(q, req, el_ret);
 		goto out;
@@ -1264,6 +1325,19 @@ get_rq:
 	 */
 	init_request_from_bio(req, bio);
 
+	/*
+	 * Barriers never go on the plug list; it was flushed above and
+	 * the barrier is queued straight away.
+	 */
+	plug = current->plug;
+	if (plug && !barrier) {
+		if (test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags) ||
+		    bio_flagged(bio, BIO_CPU_AFFINE))
+			req->cpu = blk_cpu_to_group(raw_smp_processor_id());
+		list_add_tail(&req->queuelist, &plug->list);
+		return 0;
+	}
+
 	spin_lock_irq(q->queue_lock);
 	if (test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags) ||
 	    bio_flagged(bio, BIO_CPU_AFFINE))
@@ -1278,6 +1352,75 @@ out:
 	return 0;
 }
 
+/**
+ * blk_start_plug - hold back requests submitted by the current task
+ * @plug:	The &struct blk_plug, usually on the caller's stack
+ *
+ * Description:
+ *   Requests submitted from here on are kept on @plug until
+ *   blk_finish_plug() is called, or the task goes to sleep.  Plugs
+ *   nest; only the outermost one collects requests.
+ */
+void blk_start_plug(struct blk_plug *plug)
+{
+	INIT_LIST_HEAD(&plug->list);
+
+	if (!current->plug)
+		current->plug = plug;
+}
+EXPORT_SYMBOL(blk_start_plug);
+
+static void flush_plug_list(struct blk_plug *plug)
+{
+	struct request_queue *q;
+	struct request *rq, *n;
+	unsigned long flags;
+
+	/*
+	 * One lock hold per queue.  Requests for the same queue keep
+	 * the order they were submitted in.
+	 */
+	while (!list_empty(&plug->list)) {
+		q = list_entry_rq(plug->list.next)->q;
+
+		spin_lock_irqsave(q->queue_lock, flags);
+		list_for_each_entry_safe(rq, n, &plug->list, queuelist) {
+			if (rq->q != q)
+				continue;
+			list_del_init(&rq->queuelist);
+			add_request(q, rq);
+		}
+		__blk_run_queue(q);
+		spin_unlock_irqrestore(q->queue_lock, flags);
+	}
+}
+
+/**
+ * blk_flush_plug - send the requests on a task's plug to their queues
+ * @tsk:	The task, which must be current
+ */
+void blk_flush_plug(struct task_struct *tsk)
+{
+	struct blk_plug *plug = tsk->plug;
+
+	if (plug)
+		flush_plug_list(plug);
+}
+EXPORT_SYMBOL(blk_flush_plug);
+
+/**
+ * blk_finish_plug - send off the requests collected since blk_start_plug()
+ * @plug:	The &struct blk_plug passed to blk_start_plug()
+ */
+void blk_finish_plug(struct blk_plug *plug)
+{
+	flush_plug_list(plug);
+
+	if (plug == current->plug)
+		current->plug = NULL;
+}
+EXPORT_SYMBOL(blk_finish_plug);
+
 /*
  * If bio->bi_dev is a partition, remap the location
  */
@@ -1897,6 +2040,7 @@ void blk_start_request(struct request *req)
 	if (unlikely(blk_bidi_rq(req)))
 		req->next_rq->resid_len = blk_rq_bytes(req->next_rq);
 
+	blk_latency_start_rq(req);
 	blk_add_timer(req);
 }
 EXPORT_SYMBOL(blk_start_request);
@@ -2115,6 +2259,7 @@ static void blk_finish_request(struct request *req, int error)
 	blk_delete_timer(req);
 
 	blk_account_io_done(req);
+	blk_latency_done(req);
 
 	if (req->end_io)
 		req->end_io(req, error);
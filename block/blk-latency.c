@@ -0,0 +1,170 @@
+/*
+ * Per-queue request latency histograms
+ *
+ * Requests are stamped when they are allocated and when they are handed
+ * to the driver; on completion the queue and device times are added to
+ * the histogram of the request's class.  All updates happen under the
+ * queue lock, which is already held at those points.
+ */
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/math64.h>
+
+#include "blk.h"
+
+static const char *blk_lat_class_name[BLK_LAT_NR_CLASSES] = {
+	[BLK_LAT_READ]	= "read",
+	[BLK_LAT_WRITE]	= "write",
+	[BLK_LAT_SYNC]	= "sync",
+	[BLK_LAT_FLUSH]	= "flush",
+};
+
+static const char *blk_lat_phase_name[BLK_LAT_NR_PHASES] = {
+	[BLK_LAT_QUEUE]		= "Q2D",
+	[BLK_LAT_DEVICE]	= "D2C",
+	[BLK_LAT_TOTAL]		= "Q2C",
+};
+
+static int blk_latency_class(struct request *rq)
+{
+	if (blk_barrier_rq(rq))
+		return BLK_LAT_FLUSH;
+	if (!blk_fs_request(rq) || blk_discard_rq(rq))
+		return -1;
+	if (rq_data_dir(rq) == READ)
+		return BLK_LAT_READ;
+	if (rq_is_sync(rq))
+		return BLK_LAT_SYNC;
+	return BLK_LAT_WRITE;
+}
+
+static void blk_latency_add(struct blk_latency_stat *st, u64 start, u64 end)
+{
+	u64 usecs;
+	int bucket;
+
+	usecs = end > start ? div_u64(end - start, NSEC_PER_USEC) : 0;
+
+	bucket = fls64(usecs);
+	if (bucket >= BLK_LAT_BUCKETS)
+		bucket = BLK_LAT_BUCKETS - 1;
+	st->hist[bucket]++;
+
+	if (!st->nr || usecs < st->min)
+		st->min = usecs;
+	if (usecs > st->max)
+		st->max = usecs;
+	st->total += usecs;
+	st->nr++;
+}
+
+/*
+ * Called from blk_finish_request() with the queue lock held.
+ */
+void blk_latency_done(struct request *rq)
+{
+	struct blk_latency_stat *st;
+	int class;
+	u64 now;
+
+	if (!rq->start_time_ns || !rq->io_start_time_ns)
+		return;
+
+	class = blk_latency_class(rq);
+	if (class < 0)
+		return;
+
+	now = sched_clock();
+	st = rq->q->latency.stat[class];
+
+	blk_latency_add(&st[BLK_LAT_QUEUE], rq->start_time_ns,
+			rq->io_start_time_ns);
+	blk_latency_add(&st[BLK_LAT_DEVICE], rq->io_start_time_ns, now);
+	blk_latency_add(&st[BLK_LAT_TOTAL], rq->start_time_ns, now);
+}
+
+ssize_t blk_latency_hist_show(struct request_queue *q, char *page)
+{
+	struct blk_latency *lat = &q->latency;
+	int phase, class, i;
+	ssize_t len = 0;
+
+	for (phase = BLK_LAT_QUEUE; phase <= BLK_LAT_DEVICE; phase++) {
+		len += sprintf(page + len, "%s usecs",
+			       blk_lat_phase_name[phase]);
+		for (class = 0; class < BLK_LAT_NR_CLASSES; class++)
+			len += sprintf(page + len, " %10s",
+				       blk_lat_class_name[class]);
+		len += sprintf(page + len, "\n");
+
+		for (i = 0; i < BLK_LAT_BUCKETS; i++) {
+			if (i < BLK_LAT_BUCKETS - 1)
+				len += sprintf(page + len, "<%8lu",
+					       1UL << i);
+			else
+				len += sprintf(page + len, ">=%7lu",
+					       1UL << (i - 1));
+			for (class = 0; class < BLK_LAT_NR_CLASSES; class++)
+				len += sprintf(page + len, " %10lu",
+					lat->stat[class][phase].hist[i]);
+			len += sprintf(page + len, "\n");
+		}
+	}
+
+	return len;
+}
+
+static int blk_latency_print_secs(char *page, u64 usecs)
+{
+	u32 rem;
+	u64 secs = div_u64_rem(usecs, USEC_PER_SEC, &rem);
+
+	return sprintf(page, " %3llu.%09u", (unsigned long long)secs,
+		       rem * 1000);
+}
+
+/*
+ * Same layout as the per-device tables of btt, so existing scripts
+ * that parse its output can be pointed at this file.
+ */
+ssize_t blk_latency_stats_show(struct request_queue *q, char *page)
+{
+	struct blk_latency *lat = &q->latency;
+	struct blk_latency_stat *st;
+	int phase, class;
+	ssize_t len = 0;
+
+	len += sprintf(page + len, "%15s %13s %13s %13s %11s\n",
+		       "ALL", "MIN", "AVG", "MAX", "N");
+	len += sprintf(page + len, "--------------- ------------- "
+		       "------------- ------------- -----------\n");
+
+	for (phase = 0; phase < BLK_LAT_NR_PHASES; phase++) {
+		for (class = 0; class < BLK_LAT_NR_CLASSES; class++) {
+			st = &lat->stat[class][phase];
+			if (!st->nr)
+				continue;
+
+			len += sprintf(page + len, "%s %-11s",
+				       blk_lat_phase_name[phase],
+				       blk_lat_class_name[class]);
+			len += blk_latency_print_secs(page + len, st->min);
+			len += blk_latency_print_secs(page + len,
+					div_u64(st->total, st->nr));
+			len += blk_latency_print_secs(page + len, st->max);
+			len += sprintf(page + len, " %11lu\n", st->nr);
+		}
+	}
+
+	return len;
+}
+
+ssize_t blk_latency_reset(struct request_queue *q, const char *page,
+			  size_t count)
+{
+	spin_lock_irq(q->queue_lock);
+	memset(&q->latency, 0, sizeof(q->latency));
+	spin_unlock_irq(q->queue_lock);
+
+	return count;
+}
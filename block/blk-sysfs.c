@@ -317,6 +317,20 @@ static struct queue_sysfs_entry queue_iostats_entry = {
 	.store = queue_iostats_store,
 };
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+static struct queue_sysfs_entry queue_latency_hist_entry = {
+	.attr = {.name = "latency_hist", .mode = S_IRUGO | S_IWUSR },
+	.show = blk_latency_hist_show,
+	.store = blk_latency_reset,
+};
+
+static struct queue_sysfs_entry queue_latency_stats_entry = {
+	.attr = {.name = "latency_stats", .mode = S_IRUGO | S_IWUSR },
+	.show = blk_latency_stats_show,
+	.store = blk_latency_reset,
+};
+#endif
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -332,6 +346,10 @@ static struct attribute *default_attrs[] = {
 	&queue_nomerges_entry.attr,
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
+#ifdef CONFIG_BLK_LATENCY_HIST
+	&queue_latency_hist_entry.attr,
+	&queue_latency_stats_entry.attr,
+#endif
 	NULL,
 };
 
@@ -140,6 +140,36 @@ static inline int queue_congestion_off_threshold(struct request_queue *q)
 
 #endif /* BLK_DEV_INTEGRITY */
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+static inline void blk_latency_init_rq(struct request *rq)
+{
+	rq->start_time_ns = sched_clock();
+}
+
+static inline void blk_latency_start_rq(struct request *rq)
+{
+	rq->io_start_time_ns = sched_clock();
+}
+
+void blk_latency_done(struct request *rq);
+ssize_t blk_latency_hist_show(struct request_queue *q, char *page);
+ssize_t blk_latency_stats_show(struct request_queue *q, char *page);
+ssize_t blk_latency_reset(struct request_queue *q, const char *page,
+			  size_t count);
+#else
+static inline void blk_latency_init_rq(struct request *rq)
+{
+}
+
+static inline void blk_latency_start_rq(struct request *rq)
+{
+}
+
+static inline void blk_latency_done(struct request *rq)
+{
+}
+#endif /* BLK_LATENCY_HIST */
+
 static inline int blk_cpu_to_group(int cpu)
 {
 #ifdef CONFIG_SCHED_MC
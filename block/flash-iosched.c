@@ -0,0 +1,542 @@
+/*
+ *  Flash i/o scheduler.
+ *
+ *  Based on the deadline i/o scheduler, Copyright (C) 2002 Jens Axboe.
+ *
+ *  Meant for eMMC and other flash devices, where seeks cost nothing but a
+ *  read stuck behind a pile of writes costs a lot.  Requests are kept in
+ *  plain fifos per class (reads, sync writes, async writes) and per io
+ *  priority class; there is no sorting and no idling.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+#include <linux/ioprio.h>
+#include <linux/iocontext.h>
+
+/*
+ * See Documentation/block/flash-iosched.txt
+ */
+static const int read_expire = HZ / 10;		/* target latency for reads */
+static const int sync_write_expire = HZ / 2;	/* ... for sync writes */
+static const int async_write_expire = 2 * HZ;	/* ... for async writes */
+static const int writes_starved = 4;	/* max times reads can starve a sync write */
+static const int async_depth = 1;	/* async writes in flight while reads wait */
+
+enum {
+	FLASH_READ,
+	FLASH_SYNC_WRITE,
+	FLASH_ASYNC_WRITE,
+	FLASH_NR_QUEUES,
+};
+
+/* io priority classes, highest first */
+enum {
+	FLASH_PRIO_RT,
+	FLASH_PRIO_BE,
+	FLASH_PRIO_IDLE,
+	FLASH_NR_PRIO,
+};
+
+struct flash_data {
+	/*
+	 * run time data
+	 */
+
+	/*
+	 * requests are present on both sort_list (for merging only) and
+	 * one of the fifo lists
+	 */
+	struct rb_root sort_list[2];
+	struct list_head fifo_list[FLASH_NR_PRIO][FLASH_NR_QUEUES];
+	unsigned int queued[FLASH_NR_QUEUES];
+	unsigned int starved;		/* times reads have starved sync writes */
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[FLASH_NR_QUEUES];
+	int writes_starved;
+	int async_depth;
+	int front_merges;
+};
+
+/*
+ * The fifo a request sits on, picked when it was added.  Merged requests
+ * may mix sync and async, so this is not recomputed from the flags.
+ * Until the request is added, RQ_PRIO holds the priority of the task
+ * that allocated it.
+ */
+#define RQ_PRIO(rq)		((long) (rq)->elevator_private)
+#define RQ_QUEUE(rq)		((long) (rq)->elevator_private2)
+#define RQ_SET_FIFO(rq, p, q)	do {					\
+		(rq)->elevator_private = (void *) (long) (p);		\
+		(rq)->elevator_private2 = (void *) (long) (q);		\
+	} while (0)
+
+static void flash_move_to_dispatch(struct flash_data *, struct request *);
+
+static inline struct rb_root *
+flash_rb_root(struct flash_data *fd, struct request *rq)
+{
+	return &fd->sort_list[rq_data_dir(rq)];
+}
+
+static void
+flash_add_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	struct rb_root *root = flash_rb_root(fd, rq);
+	struct request *__alias;
+
+	while (unlikely(__alias = elv_rb_add(root, rq)))
+		flash_move_to_dispatch(fd, __alias);
+}
+
+static int flash_rq_queue(struct request *rq)
+{
+	if (rq_data_dir(rq) == READ)
+		return FLASH_READ;
+
+	return rq_is_sync(rq) ? FLASH_SYNC_WRITE : FLASH_ASYNC_WRITE;
+}
+
+static int flash_class_prio(int class)
+{
+	switch (class) {
+	case IOPRIO_CLASS_RT:
+		return FLASH_PRIO_RT;
+	case IOPRIO_CLASS_IDLE:
+		return FLASH_PRIO_IDLE;
+	default:
+		return FLASH_PRIO_BE;
+	}
+}
+
+static int flash_task_prio(struct task_struct *tsk)
+{
+	int class;
+
+	if (tsk->io_context && ioprio_valid(tsk->io_context->ioprio))
+		class = task_ioprio_class(tsk->io_context);
+	else
+		class = task_nice_ioclass(tsk);
+
+	return flash_class_prio(class);
+}
+
+/*
+ * The io priority class of the request, or else of the task that
+ * allocated it.  current can't be used here: requests are added from
+ * plug flushes and requeued by the driver thread.
+ */
+static int flash_rq_prio(struct request *rq)
+{
+	int class = IOPRIO_PRIO_CLASS(req_get_ioprio(rq));
+
+	if (class != IOPRIO_CLASS_NONE)
+		return flash_class_prio(class);
+	if (rq->cmd_flags & REQ_ELVPRIV)
+		return RQ_PRIO(rq);
+	return FLASH_PRIO_BE;
+}
+
+/* Move @rq to the tail of the fifo of priority @prio */
+static void flash_move_prio(struct flash_data *fd, struct request *rq,
+			    int prio)
+{
+	list_move_tail(&rq->queuelist, &fd->fifo_list[prio][RQ_QUEUE(rq)]);
+	RQ_SET_FIFO(rq, prio, RQ_QUEUE(rq));
+}
+
+/* Runs in the context of the task allocating the request */
+static int
+flash_set_request(struct request_queue *q, struct request *rq, gfp_t gfp_mask)
+{
+	RQ_SET_FIFO(rq, flash_task_prio(current), 0);
+	return 0;
+}
+
+/*
+ * add rq to rbtree and fifo
+ */
+static void
+flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int queue = flash_rq_queue(rq);
+	const int prio = flash_rq_prio(rq);
+
+	flash_add_rq_rb(fd, rq);
+
+	/*
+	 * set expire time and add to fifo list
+	 */
+	RQ_SET_FIFO(rq, prio, queue);
+	rq_set_fifo_time(rq, jiffies + fd->fifo_expire[queue]);
+	list_add_tail(&rq->queuelist, &fd->fifo_list[prio][queue]);
+	fd->queued[queue]++;
+}
+
+/*
+ * remove rq from rbtree and fifo.
+ */
+static void flash_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	BUG_ON(!fd->queued[RQ_QUEUE(rq)]);
+	fd->queued[RQ_QUEUE(rq)]--;
+
+	rq_fifo_clear(rq);
+	elv_rb_del(flash_rb_root(fd, rq), rq);
+}
+
+static int
+flash_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *__rq;
+
+	/*
+	 * check for front merge
+	 */
+	if (fd->front_merges) {
+		sector_t sector = bio->bi_sector + bio_sectors(bio);
+
+		__rq = elv_rb_find(&fd->sort_list[bio_data_dir(bio)], sector);
+		if (__rq) {
+			BUG_ON(sector != blk_rq_pos(__rq));
+
+			if (elv_rq_merge_ok(__rq, bio)) {
+				*req = __rq;
+				return ELEVATOR_FRONT_MERGE;
+			}
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+static void flash_merged_request(struct request_queue *q,
+				 struct request *req, int type)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(flash_rb_root(fd, req), req);
+		flash_add_rq_rb(fd, req);
+	}
+
+	/* the bio may have raised the priority of the request */
+	if (flash_rq_prio(req) < RQ_PRIO(req))
+		flash_move_prio(fd, req, flash_rq_prio(req));
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+			fd->queued[RQ_QUEUE(req)]--;
+			fd->queued[RQ_QUEUE(next)]++;
+			RQ_SET_FIFO(req, RQ_PRIO(next), RQ_QUEUE(next));
+		}
+		if (RQ_PRIO(next) < RQ_PRIO(req))
+			flash_move_prio(fd, req, RQ_PRIO(next));
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	flash_remove_request(q, next);
+}
+
+/*
+ * move request from sort list to dispatch queue.  There is no head
+ * position to keep track of, so requests simply go on the tail.
+ */
+static void
+flash_move_to_dispatch(struct flash_data *fd, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	flash_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+/*
+ * Return the oldest request of the given class if it has expired,
+ * looking at every priority level.
+ */
+static struct request *flash_expired_request(struct flash_data *fd, int queue)
+{
+	struct request *rq, *oldest = NULL;
+	int prio;
+
+	if (!fd->queued[queue])
+		return NULL;
+
+	for (prio = 0; prio < FLASH_NR_PRIO; prio++) {
+		if (list_empty(&fd->fifo_list[prio][queue]))
+			continue;
+
+		rq = rq_entry_fifo(fd->fifo_list[prio][queue].next);
+		if (!oldest || time_before(rq_fifo_time(rq), rq_fifo_time(oldest)))
+			oldest = rq;
+	}
+
+	if (oldest && time_after(jiffies, rq_fifo_time(oldest)))
+		return oldest;
+
+	return NULL;
+}
+
+/*
+ * Async writes are only let through a few at a time while reads are
+ * waiting, however long they have been queued.
+ */
+static int flash_async_throttled(struct request_queue *q, struct flash_data *fd)
+{
+	return fd->queued[FLASH_READ] &&
+	       q->in_flight[BLK_RW_ASYNC] >= fd->async_depth;
+}
+
+/*
+ * flash_dispatch_requests selects the next request: an expired one if
+ * there is one, otherwise the highest priority class with work, reads
+ * before sync writes before async writes.
+ */
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *rq;
+	int queue, prio;
+
+	for (queue = 0; queue < FLASH_NR_QUEUES; queue++) {
+		if (queue == FLASH_ASYNC_WRITE && !force &&
+		    flash_async_throttled(q, fd))
+			break;
+
+		rq = flash_expired_request(fd, queue);
+		if (rq)
+			goto dispatch_request;
+	}
+
+	for (prio = 0; prio < FLASH_NR_PRIO; prio++) {
+		struct list_head *fifo = fd->fifo_list[prio];
+
+		if (!list_empty(&fifo[FLASH_READ])) {
+			if (!list_empty(&fifo[FLASH_SYNC_WRITE]) &&
+			    fd->starved++ >= fd->writes_starved)
+				queue = FLASH_SYNC_WRITE;
+			else
+				queue = FLASH_READ;
+			goto dispatch_find_request;
+		}
+
+		if (!list_empty(&fifo[FLASH_SYNC_WRITE])) {
+			queue = FLASH_SYNC_WRITE;
+			goto dispatch_find_request;
+		}
+
+		if (!list_empty(&fifo[FLASH_ASYNC_WRITE])) {
+			/*
+			 * Leave the slot to reads queued at a lower
+			 * priority, if any.
+			 */
+			if (!force && flash_async_throttled(q, fd))
+				continue;
+			queue = FLASH_ASYNC_WRITE;
+			goto dispatch_find_request;
+		}
+	}
+
+	return 0;
+
+dispatch_find_request:
+	rq = rq_entry_fifo(fd->fifo_list[prio][queue].next);
+
+dispatch_request:
+	if (RQ_QUEUE(rq) == FLASH_SYNC_WRITE)
+		fd->starved = 0;
+
+	flash_move_to_dispatch(fd, rq);
+
+	return 1;
+}
+
+static int flash_queue_empty(struct request_queue *q)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	return !fd->queued[FLASH_READ] && !fd->queued[FLASH_SYNC_WRITE] &&
+	       !fd->queued[FLASH_ASYNC_WRITE];
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+	int queue;
+
+	for (queue = 0; queue < FLASH_NR_QUEUES; queue++)
+		BUG_ON(fd->queued[queue]);
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+	int prio, queue;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	for (prio = 0; prio < FLASH_NR_PRIO; prio++)
+		for (queue = 0; queue < FLASH_NR_QUEUES; queue++)
+			INIT_LIST_HEAD(&fd->fifo_list[prio][queue]);
+	fd->sort_list[READ] = RB_ROOT;
+	fd->sort_list[WRITE] = RB_ROOT;
+	fd->fifo_expire[FLASH_READ] = read_expire;
+	fd->fifo_expire[FLASH_SYNC_WRITE] = sync_write_expire;
+	fd->fifo_expire[FLASH_ASYNC_WRITE] = async_write_expire;
+	fd->writes_starved = writes_starved;
+	fd->async_depth = async_depth;
+	fd->front_merges = 1;
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_read_expire_show, fd->fifo_expire[FLASH_READ], 1);
+SHOW_FUNCTION(flash_sync_write_expire_show, fd->fifo_expire[FLASH_SYNC_WRITE], 1);
+SHOW_FUNCTION(flash_async_write_expire_show, fd->fifo_expire[FLASH_ASYNC_WRITE], 1);
+SHOW_FUNCTION(flash_writes_starved_show, fd->writes_starved, 0);
+SHOW_FUNCTION(flash_async_depth_show, fd->async_depth, 0);
+SHOW_FUNCTION(flash_front_merges_show, fd->front_merges, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_read_expire_store, &fd->fifo_expire[FLASH_READ], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_sync_write_expire_store, &fd->fifo_expire[FLASH_SYNC_WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_async_write_expire_store, &fd->fifo_expire[FLASH_ASYNC_WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_writes_starved_store, &fd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_async_depth_store, &fd->async_depth, 1, INT_MAX, 0);
+STORE_FUNCTION(flash_front_merges_store, &fd->front_merges, 0, 1, 0);
+#undef STORE_FUNCTION
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(read_expire),
+	FD_ATTR(sync_write_expire),
+	FD_ATTR(async_write_expire),
+	FD_ATTR(writes_starved),
+	FD_ATTR(async_depth),
+	FD_ATTR(front_merges),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_fn = 		flash_merge,
+		.elevator_merged_fn =		flash_merged_request,
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_set_req_fn =		flash_set_request,
+		.elevator_queue_empty_fn =	flash_queue_empty,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("flash IO scheduler");
@@ -16,6 +16,8 @@
 #include <linux/poll.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/init.h>
 #include <linux/input.h>
@@ -37,46 +39,78 @@ struct evdev {
 	struct device dev;
 };
 
+/*
+ * The event queue lives in a vmalloc_user() area so that it can be
+ * mapped by the client.  head is where the next event is stored and
+ * packet_head the end of the last complete packet; only the latter is
+ * visible to readers, through ring->head.  The tail is kept in the ring
+ * itself, as an mmap() reader advances it from user space.
+ */
 struct evdev_client {
-	int head;
-	int tail;
+	unsigned int head;
+	unsigned int packet_head;
 	spinlock_t buffer_lock; /* protects access to buffer, head and tail */
 	struct fasync_struct *fasync;
 	struct evdev *evdev;
 	struct list_head node;
 	struct wake_lock wake_lock;
 	char name[28];
-	int bufsize;
+	bool mapped;
+	unsigned int bufsize;
+	struct input_event_ring *ring;
 	struct input_event *buffer;
 };
 
 static struct evdev *evdev_table[EVDEV_MINORS];
 static DEFINE_MUTEX(evdev_table_mutex);
 
+/* User space may write anything into the tail, never trust it */
+static inline unsigned int evdev_tail(struct evdev_client *client)
+{
+	return ACCESS_ONCE(client->ring->tail) & (client->bufsize - 1);
+}
+
+static inline bool evdev_packet_ready(struct evdev_client *client)
+{
+	return client->packet_head != evdev_tail(client);
+}
+
 static void evdev_pass_event(struct evdev_client *client,
 			     struct input_event *event)
 {
 	bool buffer_overflow = false;
-	/*
-	 * Interrupts are disabled, just acquire the lock.
-	 * Make sure we don't leave with the client buffer
-	 * "empty" by having client->head == client->tail.
-	 */
+
+	/* Interrupts are disabled, just acquire the lock. */
 	spin_lock(&client->buffer_lock);
 	wake_lock_timeout(&client->wake_lock, 5 * HZ);
-	do {
-		client->buffer[client->head++] = *event;
-		client->head &= client->bufsize - 1;
-		if (client->head == client->tail)
-			buffer_overflow = true;
-	} while (client->head == client->tail);
+
+	client->buffer[client->head++] = *event;
+	client->head &= client->bufsize - 1;
+
+	if (unlikely(client->head == evdev_tail(client))) {
+		/*
+		 * Drop everything but the event we just stored, it
+		 * becomes visible with the rest of its packet.
+		 */
+		client->ring->tail = (client->head - 1) & (client->bufsize - 1);
+		client->packet_head = client->ring->tail;
+		client->ring->head = client->packet_head;
+		buffer_overflow = true;
+	}
+
+	if (event->type == EV_SYN && event->code == SYN_REPORT) {
+		client->packet_head = client->head;
+		/* Events must be in place before a mapped reader sees head */
+		smp_wmb();
+		client->ring->head = client->packet_head;
+		kill_fasync(&client->fasync, SIGIO, POLL_IN);
+	}
+
 	spin_unlock(&client->buffer_lock);
 
 	if (buffer_overflow)
 		printk(KERN_ERR "evdev: %s: buffer overflow\n",
 			client->name);
-
-	kill_fasync(&client->fasync, SIGIO, POLL_IN);
 }
 
 /*
@@ -108,7 +142,9 @@ static void evdev_event(struct input_handle *handle,
 
 	rcu_read_unlock();
 
-	wake_up_interruptible(&evdev->wait);
+	/* Readers only see whole packets, don't wake them up before that */
+	if (type == EV_SYN && code == SYN_REPORT)
+		wake_up_interruptible(&evdev->wait);
 }
 
 static int evdev_fasync(int fd, struct file *file, int on)
@@ -205,6 +241,12 @@ static unsigned int evdev_compute_buffer_size(struct input_dev *dev)
 	return roundup_pow_of_two(n_events);
 }
 
+static size_t evdev_ring_bytes(unsigned int bufsize)
+{
+	return PAGE_ALIGN(sizeof(struct input_event_ring) +
+			  bufsize * sizeof(struct input_event));
+}
+
 static int evdev_open_device(struct evdev *evdev)
 {
 	int retval;
@@ -264,7 +306,7 @@ static int evdev_release(struct inode *inode, struct file *file)
 	evdev_detach_client(evdev, client);
 	wake_lock_destroy(&client->wake_lock);
 
-	kfree(client->buffer);
+	vfree(client->ring);
 	kfree(client);
 
 	evdev_close_device(evdev);
@@ -302,13 +344,14 @@ static int evdev_open(struct inode *inode, struct file *file)
 	}
 
 	bufsize = evdev_compute_buffer_size(evdev->handle.dev);
-	client->buffer = kmalloc(bufsize * sizeof(struct input_event),
-				 GFP_KERNEL);
-	if (!client->buffer) {
+	client->ring = vmalloc_user(evdev_ring_bytes(bufsize));
+	if (!client->ring) {
 		error = -ENOMEM;
 		goto err_free_client;
 	}
 
+	client->ring->size = bufsize;
+	client->buffer = client->ring->events;
 	client->bufsize = bufsize;
 	spin_lock_init(&client->buffer_lock);
 	snprintf(client->name, sizeof(client->name), "%s-%d",
@@ -326,7 +369,7 @@ static int evdev_open(struct inode *inode, struct file *file)
 
  err_detach_client:
 	evdev_detach_client(evdev, client);
-	kfree(client->buffer);
+	vfree(client->ring);
 err_free_client:
 	kfree(client);
  err_put_evdev:
@@ -371,15 +414,18 @@ static ssize_t evdev_write(struct file *file, const char __user *buffer,
 static int evdev_fetch_next_event(struct evdev_client *client,
 				  struct input_event *event)
 {
+	unsigned int tail;
 	int have_event;
 
 	spin_lock_irq(&client->buffer_lock);
 
-	have_event = client->head != client->tail;
+	tail = evdev_tail(client);
+	have_event = client->packet_head != tail;
 	if (have_event) {
-		*event = client->buffer[client->tail++];
-		client->tail &= client->bufsize - 1;
-		if (client->head == client->tail)
+		*event = client->buffer[tail++];
+		tail &= client->bufsize - 1;
+		client->ring->tail = tail;
+		if (client->packet_head == tail)
 			wake_unlock(&client->wake_lock);
 	}
 
@@ -399,12 +445,12 @@ static ssize_t evdev_read(struct file *file, char __user *buffer,
 	if (count < input_event_size())
 		return -EINVAL;
 
-	if (client->head == client->tail && evdev->exist &&
+	if (!evdev_packet_ready(client) && evdev->exist &&
 	    (file->f_flags & O_NONBLOCK))
 		return -EAGAIN;
 
 	retval = wait_event_interruptible(evdev->wait,
-		client->head != client->tail || !evdev->exist);
+		evdev_packet_ready(client) || !evdev->exist);
 	if (retval)
 		return retval;
 
@@ -428,12 +474,41 @@ static unsigned int evdev_poll(struct file *file, poll_table *wait)
 {
 	struct evdev_client *client = file->private_data;
 	struct evdev *evdev = client->evdev;
+	bool ready;
 
 	poll_wait(file, &evdev->wait, wait);
-	return ((client->head == client->tail) ? 0 : (POLLIN | POLLRDNORM)) |
+
+	ready = evdev_packet_ready(client);
+	if (!ready && client->mapped) {
+		/*
+		 * A mapped reader consumes events behind our back, so
+		 * this is the first chance to notice the queue drained.
+		 */
+		spin_lock_irq(&client->buffer_lock);
+		if (!evdev_packet_ready(client))
+			wake_unlock(&client->wake_lock);
+		spin_unlock_irq(&client->buffer_lock);
+	}
+
+	return (ready ? (POLLIN | POLLRDNORM) : 0) |
 		(evdev->exist ? 0 : (POLLHUP | POLLERR));
 }
 
+static int evdev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct evdev_client *client = file->private_data;
+
+	/* The ring holds native events, compat tasks have to read() */
+	if (input_event_size() != sizeof(struct input_event))
+		return -EINVAL;
+
+	if (vma->vm_pgoff)
+		return -EINVAL;
+
+	client->mapped = true;
+	return remap_vmalloc_range(vma, client->ring, 0);
+}
+
 #ifdef CONFIG_COMPAT
 
 #define BITS_PER_LONG_COMPAT (sizeof(compat_long_t) * 8)
@@ -631,6 +706,9 @@ static long evdev_do_ioctl(struct file *file, unsigned int cmd,
 		else
 			return evdev_ungrab(evdev, client);
 
+	case EVIOCGRINGSIZE:
+		return put_user(evdev_ring_bytes(client->bufsize), ip);
+
 	default:
 
 		if (_IOC_TYPE(cmd) != 'E')
@@ -776,6 +854,7 @@ static const struct file_operations evdev_fops = {
 	.read		= evdev_read,
 	.write		= evdev_write,
 	.poll		= evdev_poll,
+	.mmap		= evdev_mmap,
 	.open		= evdev_open,
 	.release	= evdev_release,
 	.unlocked_ioctl	= evdev_ioctl,
@@ -120,6 +120,7 @@ static inline void walkera0701_parse_frame(struct walkera_dev *w)
 	input_report_abs(w->input_dev, ABS_RUDDER, val4);
 	input_report_abs(w->input_dev, ABS_MISC, val7);
 	input_report_key(w->input_dev, BTN_GEAR_DOWN, val5 > 0);
+	input_sync(w->input_dev);
 }
 
 static inline int read_ack(struct pardevice *p)
@@ -123,6 +123,7 @@ static void poll_finished(void)
 		scode = hil_dev.data[1] >> 1;
 		key = hphilkeyb_keycode[scode];
 		input_report_key(hil_dev.dev, key, down);
+		input_sync(hil_dev.dev);
 		break;
 	}
 	hil_dev.curdev = 0;
@@ -182,6 +182,7 @@ static void tegra_kbc_report_keys(struct tegra_kbc *kbc, int *fifo)
 		} else
 			WARN_ON(1);
 	}
+	input_sync(kbc->idev);
 }
 
 static void tegra_kbc_key_repeat(struct work_struct *work)
@@ -204,6 +205,7 @@ static void tegra_kbc_key_repeat(struct work_struct *work)
 					continue;
 				input_report_key(kbc->idev, fifo[i], 0);
 			}
+			input_sync(kbc->idev);
 			break;
 		}
 		tegra_kbc_report_keys(kbc, fifo);
@@ -298,6 +298,7 @@ static int nvec_keyboard_recv(void *arg)
 			code = extcode_tab_us102[code];
 			input_report_key(keyboard->input_dev, code, pressed);
 		}
+		input_sync(keyboard->input_dev);
 	}
 
 	return 0;
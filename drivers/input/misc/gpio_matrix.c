@@ -124,6 +124,7 @@ static void report_key(struct gpio_kp *kp, int key_index, int out, int in)
 					out, in, mi->output_gpios[out],
 					mi->input_gpios[in], pressed);
 			input_report_key(kp->input_devs->dev[dev], keycode, pressed);
+			input_sync(kp->input_devs->dev[dev]);
 		}
 	}
 }
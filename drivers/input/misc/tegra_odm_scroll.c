@@ -51,17 +51,22 @@ static int scroll_thread(void *pdata)
 		Events = NvOdmScrollWheelGetEvent(scroll->odm_dev);
 		if (Events & NvOdmScrollWheelEvent_RotateAntiClockWise) {
 			input_report_key(scroll->input_dev, KEY_UP, 1);
+			input_sync(scroll->input_dev);
 			input_report_key(scroll->input_dev, KEY_UP, 0);
+			input_sync(scroll->input_dev);
 		}
 		if (Events & NvOdmScrollWheelEvent_RotateClockWise) {
 			input_report_key(scroll->input_dev, KEY_DOWN, 1);
+			input_sync(scroll->input_dev);
 			input_report_key(scroll->input_dev, KEY_DOWN, 0);
+			input_sync(scroll->input_dev);
 		}
 
 		if (Events & NvOdmScrollWheelEvent_Press)
 			input_report_key(scroll->input_dev, KEY_ENTER, 1);
 		else if (Events & NvOdmScrollWheelEvent_Release)
 			input_report_key(scroll->input_dev, KEY_ENTER, 0);
+		input_sync(scroll->input_dev);
 	}
 	return 0;
 }
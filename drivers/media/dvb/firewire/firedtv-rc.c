@@ -186,5 +186,7 @@ void fdtv_handle_rc(struct firedtv *fdtv, unsigned int code)
 	}
 
 	input_report_key(fdtv->remote_ctrl_dev, code, 1);
+	input_sync(fdtv->remote_ctrl_dev);
 	input_report_key(fdtv->remote_ctrl_dev, code, 0);
+	input_sync(fdtv->remote_ctrl_dev);
 }
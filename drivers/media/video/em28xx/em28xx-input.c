@@ -425,9 +425,11 @@ static void em28xx_query_sbutton(struct work_struct *work)
 		/* Not emulate the keypress */
 		input_report_key(dev->sbutton_input_dev, EM28XX_SNAPSHOT_KEY,
 				 1);
+		input_sync(dev->sbutton_input_dev);
 		/* Now unpress the key */
 		input_report_key(dev->sbutton_input_dev, EM28XX_SNAPSHOT_KEY,
 				 0);
+		input_sync(dev->sbutton_input_dev);
 	}
 
 	/* Schedule next poll */
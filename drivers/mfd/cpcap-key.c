@@ -99,8 +99,10 @@ void cpcap_broadcast_key_event(struct cpcap_device *cpcap,
 	if (DUMP_WAKELOCK_WHILE_POWERKEY && code == KEY_END
 		&& value == 1)
 		dump_active_lock_static();
-	if (key && key->input_dev)
+	if (key && key->input_dev) {
 		input_report_key(key->input_dev, code, value);
+		input_sync(key->input_dev);
+	}
 }
 EXPORT_SYMBOL(cpcap_broadcast_key_event);
 
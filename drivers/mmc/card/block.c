@@ -63,6 +63,31 @@ struct mmc_blk_data {
 
 	unsigned int	usage;
 	unsigned int	read_only;
+	unsigned int	flags;
+#define MMC_BLK_CMD23		(1 << 0)	/* Can do SET_BLOCK_COUNT */
+#define MMC_BLK_REL_WR		(1 << 1)	/* Can do reliable writes */
+#define MMC_BLK_PACKED_CMD	(1 << 2)	/* Can do packed writes */
+
+	struct list_head discards;	/* sectors to erase when idle */
+	unsigned int	nr_discards;
+	unsigned long	discard_stamp;	/* jiffies of the last discard */
+};
+
+/*
+ * Discards are completed as soon as they are queued, and the sectors
+ * they cover are remembered (sorted and merged) until the queue goes
+ * idle.  The card is then erased in whole erase groups, a chunk at a
+ * time so that new requests are not held up for long.  Writes take
+ * their sectors back out of the list before going to the card.
+ */
+#define MMC_BLK_MAX_DISCARDS	256
+#define MMC_BLK_ERASE_CHUNK	8192		/* sectors per idle erase */
+#define MMC_BLK_DISCARD_DELAY	(HZ / 4)	/* let discards coalesce */
+
+struct mmc_blk_discard {
+	struct list_head	list;
+	sector_t		from;
+	sector_t		nr;
 };
 
 static DEFINE_MUTEX(open_lock);
@@ -100,6 +125,15 @@ static void mmc_blk_put(struct mmc_blk_data *md)
 		if (md->bounce)
 			kfree(md->bounce);
 
+		while (!list_empty(&md->discards)) {
+			struct mmc_blk_discard *d;
+
+			d = list_first_entry(&md->discards,
+					     struct mmc_blk_discard, list);
+			list_del(&d->list);
+			kfree(d);
+		}
+
 		put_disk(md->disk);
 		kfree(md);
 	}
@@ -149,11 +183,11 @@ static const struct block_device_operations mmc_bdops = {
 	.owner			= THIS_MODULE,
 };
 
-struct mmc_blk_request {
-	struct mmc_request	mrq;
-	struct mmc_command	cmd;
-	struct mmc_command	stop;
-	struct mmc_data		data;
+enum mmc_blk_status {
+	MMC_BLK_SUCCESS = 0,
+	MMC_BLK_PARTIAL,
+	MMC_BLK_RETRY_SINGLE,
+	MMC_BLK_CMD_ERR,
 };
 
 static u32 mmc_sd_num_wr_blocks(struct mmc_card *card)
@@ -424,273 +458,768 @@ static bool mmc_handle_toshiba_write(struct mmc_queue *mq,
 	return true;
 }
 
-static int mmc_blk_xfer_rq(struct mmc_blk_data *md,
-	struct request *req, unsigned int *bytes_xfered)
+/*
+ * Decide whether a write has to take the synchronous Toshiba path above.
+ * That path issues several commands of its own, so it cannot overlap
+ * with another request on the bus.
+ */
+static bool mmc_blk_toshiba_sync(struct mmc_blk_data *md, struct request *req)
 {
-	struct mmc_queue *mq = &md->queue;
-	struct mmc_card *card = mq->card;
-	struct mmc_blk_request brq;
-	int ret = 1;
-	int disable_multi = 0;
-	int retry = 0;
+	return md->bounce && rq_data_dir(req) == WRITE &&
+	       blk_rq_sectors(req) >= TOSHIBA_LOW_THRESHOLD &&
+	       blk_rq_sectors(req) <= TOSHIBA_HIGH_THRESHOLD;
+}
 
-#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
-	if (mmc_bus_needs_resume(card->host)) {
-		mmc_resume_bus(card->host);
-		mmc_blk_set_blksize(md, card);
+static int mmc_blk_err_check(struct mmc_card *card,
+			     struct mmc_async_req *areq)
+{
+	struct mmc_queue_req *mq_mrq = container_of(areq, struct mmc_queue_req,
+						    mmc_active);
+	struct mmc_blk_request *brq = &mq_mrq->brq;
+	struct request *req = mq_mrq->req;
+	struct mmc_command cmd;
+	u32 status = 0;
+	int ret = 0;
+
+	/*
+	 * Check for errors here, but don't bail out until later as we
+	 * need to wait for the card to leave programming mode even when
+	 * things go wrong.
+	 */
+	if (brq->sbc.error || brq->cmd.error || brq->data.error ||
+	    brq->stop.error) {
+		if (brq->data.blocks > 1 && rq_data_dir(req) == READ) {
+			/* Redo read one sector at a time */
+			printk(KERN_WARNING "%s: retrying using single "
+			       "block read\n", req->rq_disk->disk_name);
+			return MMC_BLK_RETRY_SINGLE;
+		}
+		status = get_card_status(card, req);
 	}
-#endif
 
-	BUG_ON(!bytes_xfered);
+	if (brq->sbc.error) {
+		ret = brq->sbc.error;
+		printk(KERN_ERR "%s: error %d sending SET_BLOCK_COUNT "
+		       "command, response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->sbc.error,
+		       brq->sbc.resp[0], status);
+	}
 
-	do {
-		struct mmc_command cmd;
-		u32 readcmd, writecmd, status = 0;
+	if (brq->cmd.error) {
+		ret = brq->cmd.error;
+		printk(KERN_ERR "%s: error %d sending read/write "
+		       "command, response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->cmd.error,
+		       brq->cmd.resp[0], status);
+	}
 
-		memset(&brq, 0, sizeof(struct mmc_blk_request));
-		brq.mrq.cmd = &brq.cmd;
-		brq.mrq.data = &brq.data;
+	if (brq->data.error) {
+		ret = brq->data.error;
+		if (brq->data.error == -ETIMEDOUT && brq->mrq.stop)
+			/* 'Stop' response contains card status */
+			status = brq->mrq.stop->resp[0];
+		printk(KERN_ERR "%s: error %d transferring data,"
+		       " sector %u, nr %u, card status %#x\n",
+		       req->rq_disk->disk_name, brq->data.error,
+		       (unsigned)blk_rq_pos(req),
+		       (unsigned)blk_rq_sectors(req), status);
+	}
 
-		brq.cmd.arg = blk_rq_pos(req);
-		if (!mmc_card_blockaddr(card))
-			brq.cmd.arg <<= 9;
-		brq.cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
-		brq.data.blksz = 512;
-		brq.stop.opcode = MMC_STOP_TRANSMISSION;
-		brq.stop.arg = 0;
-		brq.stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
-		brq.data.blocks = blk_rq_sectors(req);
+	if (brq->stop.error) {
+		ret = brq->stop.error;
+		printk(KERN_ERR "%s: error %d sending stop command, "
+		       "response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->stop.error,
+		       brq->stop.resp[0], status);
+	}
 
-		/*
-		 * The block layer doesn't support all sector count
-		 * restrictions, so we need to be prepared for too big
-		 * requests.
-		 */
-		if (brq.data.blocks > card->host->max_blk_count)
-			brq.data.blocks = card->host->max_blk_count;
+	/*
+	 * We need to wait for the card to leave programming mode
+	 * even when things go wrong.
+	 */
+	if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ) {
+		do {
+			int err;
+			cmd.opcode = MMC_SEND_STATUS;
+			cmd.arg = card->rca << 16;
+			cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+			err = mmc_wait_for_cmd(card->host, &cmd, 5);
+			if (err) {
+				printk(KERN_ERR "%s: error %d requesting status\n",
+				       req->rq_disk->disk_name, err);
+				ret = err;
+				break;
+			}
+			/*
+			 * Some cards mishandle the status bits,
+			 * so make sure to check both the busy
+			 * indication and the card state.
+			 */
+		} while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
+			(R1_CURRENT_STATE(cmd.resp[0]) == 7));
+	}
 
+	if (ret) {
 		/*
-		 * After a read error, we redo the request one sector at a time
-		 * in order to accurately determine which sectors can be read
-		 * successfully.
+		 * Adjust the number of bytes transferred.
+		 *
+		 * For reads we just fail the entire chunk as that
+		 * should be safe in all cases.
+		 *
+		 * If this is an SD card and we're writing, we can ask
+		 * the card for known good sectors.
+		 *
+		 * If the card is not SD, we can still ok written
+		 * sectors as reported by the controller (which might
+		 * be less than the real number of written sectors, but
+		 * never more).
 		 */
-		if (disable_multi && brq.data.blocks > 1)
-			brq.data.blocks = 1;
+		if (rq_data_dir(req) == READ)
+			brq->data.bytes_xfered = 0;
+		else if (mmc_card_sd(card)) {
+			u32 blocks = mmc_sd_num_wr_blocks(card);
+			if (blocks == (u32)-1)
+				brq->data.bytes_xfered = 0;
+			else
+				brq->data.bytes_xfered = blocks << 9;
+		}
+		return MMC_BLK_CMD_ERR;
+	}
 
-		if (brq.data.blocks > 1) {
-			/* SPI multiblock writes terminate using a special
-			 * token, not a STOP_TRANSMISSION request.
-			 */
-			if (!mmc_host_is_spi(card->host)
-					|| rq_data_dir(req) == READ)
-				brq.mrq.stop = &brq.stop;
-			readcmd = MMC_READ_MULTIPLE_BLOCK;
-			writecmd = MMC_WRITE_MULTIPLE_BLOCK;
-		} else {
-			brq.mrq.stop = NULL;
-			readcmd = MMC_READ_SINGLE_BLOCK;
-			writecmd = MMC_WRITE_BLOCK;
+	/*
+	 * A request that was cut short (host limits or the Toshiba page
+	 * split) must not let the next request onto the bus before its
+	 * remainder has been sent.
+	 */
+	if (brq->data.bytes_xfered < blk_rq_bytes(req))
+		return MMC_BLK_PARTIAL;
+
+	return MMC_BLK_SUCCESS;
+}
+
+/*
+ * A failed packed write may still have written some of its entries.
+ * The card says which entry it gave up on; everything before that one
+ * made it.
+ */
+static int mmc_blk_packed_err_check(struct mmc_card *card,
+				    struct mmc_async_req *areq)
+{
+	struct mmc_queue_req *mq_rq = container_of(areq, struct mmc_queue_req,
+						    mmc_active);
+	struct request *req = mq_rq->req;
+	int status;
+	u8 *ext_csd;
+
+	mq_rq->packed_fail_idx = 0;
+
+	status = mmc_blk_err_check(card, areq);
+	if (status == MMC_BLK_SUCCESS)
+		return status;
+
+	ext_csd = kmalloc(512, GFP_KERNEL);
+	if (!ext_csd)
+		return status;
+
+	if (mmc_send_ext_csd(card, ext_csd)) {
+		printk(KERN_ERR "%s: error reading EXT_CSD after packed "
+		       "write\n", req->rq_disk->disk_name);
+	} else if ((ext_csd[EXT_CSD_EXP_EVENTS_STATUS] &
+		    EXT_CSD_PACKED_FAILURE) &&
+		   (ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
+		    EXT_CSD_PACKED_INDEXED_ERROR) &&
+		   ext_csd[EXT_CSD_PACKED_FAILURE_INDEX]) {
+		mq_rq->packed_fail_idx =
+			ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] - 1;
+	}
+
+	kfree(ext_csd);
+
+	return status;
+}
+
+/*
+ * Writes the filesystem wants on the media in one piece: FUA and
+ * metadata writes, and, since the queue drains around barriers instead
+ * of issuing FUA, the barrier write itself.
+ */
+static bool mmc_blk_rel_wr(struct mmc_blk_data *md, struct request *req)
+{
+	return (md->flags & MMC_BLK_REL_WR) && rq_data_dir(req) == WRITE &&
+	       (blk_fua_rq(req) || rq_is_meta(req) || blk_barrier_rq(req));
+}
+
+/*
+ * Without enhanced reliable write the card only takes reliable writes
+ * of exactly REL_WR_SEC_C sectors at a REL_WR_SEC_C aligned address,
+ * or of a single sector.
+ */
+static void mmc_blk_apply_rel_wr(struct mmc_blk_request *brq,
+				 struct mmc_card *card, struct request *req)
+{
+	unsigned int rel_sectors = card->ext_csd.rel_wr_sec_c;
+
+	if (card->ext_csd.rel_param & EXT_CSD_WR_REL_PARAM_EN)
+		return;
+
+	if (blk_rq_pos(req) % rel_sectors)
+		brq->data.blocks = 1;
+
+	if (brq->data.blocks > rel_sectors)
+		brq->data.blocks = rel_sectors;
+	else if (brq->data.blocks < rel_sectors)
+		brq->data.blocks = 1;
+}
+
+static void mmc_blk_packed_hdr_wrq_prep(struct mmc_queue_req *mqrq,
+					struct mmc_card *card,
+					struct mmc_queue *mq)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	struct request *prq;
+	__le32 *hdr = mqrq->packed_cmd_hdr;
+	u32 arg;
+	int i = 1;
+
+	memset(hdr, 0, MMC_PACKED_HDR_SZ);
+	hdr[0] = cpu_to_le32((mqrq->packed_num << 16) |
+			     (MMC_PACKED_CMD_WR << 8) | MMC_PACKED_CMD_VER);
+	list_for_each_entry(prq, &mqrq->packed_list, queuelist) {
+		arg = blk_rq_sectors(prq);
+		if (mmc_blk_rel_wr(md, prq))
+			arg |= MMC_CMD23_ARG_REL_WR;
+		hdr[i * 2] = cpu_to_le32(arg);
+
+		arg = blk_rq_pos(prq);
+		if (!mmc_card_blockaddr(card))
+			arg <<= 9;
+		hdr[i * 2 + 1] = cpu_to_le32(arg);
+		i++;
+	}
+
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.sbc = &brq->sbc;
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+	brq->mrq.stop = &brq->stop;
+
+	/* The header takes up the first block of the transfer. */
+	brq->sbc.opcode = MMC_SET_BLOCK_COUNT;
+	brq->sbc.arg = MMC_CMD23_ARG_PACKED | (mqrq->packed_blocks + 1);
+	brq->sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	brq->cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	brq->data.blksz = 512;
+	brq->data.blocks = mqrq->packed_blocks + 1;
+	brq->data.flags |= MMC_DATA_WRITE;
+
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+
+	mmc_set_data_timeout(&brq->data, card);
+
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
+
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_packed_err_check;
+
+	mmc_queue_bounce_pre(mqrq);
+}
+
+static void mmc_blk_discard_add(struct mmc_blk_data *md, sector_t from,
+				sector_t nr)
+{
+	struct mmc_blk_discard *d, *tmp, *new = NULL;
+	sector_t end = from + nr;
+
+	list_for_each_entry_safe(d, tmp, &md->discards, list) {
+		if (d->from + d->nr < from)
+			continue;
+		if (d->from > end)
+			break;
+		/* Overlapping or adjacent, fold it into the new range */
+		from = min(from, d->from);
+		end = max(end, d->from + d->nr);
+		list_del(&d->list);
+		md->nr_discards--;
+		if (new)
+			kfree(d);
+		else
+			new = d;
+	}
+
+	/* Dropping a discard only costs us the erase */
+	if (!new) {
+		if (md->nr_discards >= MMC_BLK_MAX_DISCARDS)
+			return;
+		new = kmalloc(sizeof(*new), GFP_NOIO);
+		if (!new)
+			return;
+	}
+
+	new->from = from;
+	new->nr = end - from;
+	/* before the first range past us, or at the tail */
+	list_add_tail(&new->list, &d->list);
+	md->nr_discards++;
+	md->discard_stamp = jiffies;
+}
+
+static void mmc_blk_discard_cancel(struct mmc_blk_data *md, sector_t from,
+				   sector_t nr)
+{
+	struct mmc_blk_discard *d, *tmp, *split;
+	sector_t end = from + nr;
+
+	list_for_each_entry_safe(d, tmp, &md->discards, list) {
+		sector_t d_end = d->from + d->nr;
+
+		if (d_end <= from)
+			continue;
+		if (d->from >= end)
+			break;
+
+		if (d->from < from && d_end > end) {
+			/* Punch a hole; if that fails, forget the tail */
+			d->nr = from - d->from;
+			split = kmalloc(sizeof(*split), GFP_NOIO);
+			if (split) {
+				split->from = end;
+				split->nr = d_end - end;
+				list_add(&split->list, &d->list);
+				md->nr_discards++;
+			}
+			break;
 		}
 
-		if (rq_data_dir(req) == READ) {
-			brq.cmd.opcode = readcmd;
-			brq.data.flags |= MMC_DATA_READ;
+		if (d->from < from) {
+			d->nr = from - d->from;
+		} else if (d_end > end) {
+			d->nr = d_end - end;
+			d->from = end;
 		} else {
-			brq.cmd.opcode = writecmd;
-			brq.data.flags |= MMC_DATA_WRITE;
+			list_del(&d->list);
+			md->nr_discards--;
+			kfree(d);
 		}
+	}
+}
+
+/*
+ * Pull the write requests queued behind @req into the current slot, to
+ * be sent as one packed command.  Returns the number of requests packed,
+ * or 0 if @req goes out on its own.
+ */
+static unsigned int mmc_blk_prep_packed_list(struct mmc_queue *mq,
+					     struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = mq->card;
+	struct mmc_host *host = card->host;
+	struct mmc_queue_req *mqrq = mq->mqrq_cur;
+	struct request_queue *q = mq->queue;
+	struct request *next;
+	unsigned int max_num, max_blocks, max_segs;
+	unsigned int num, blocks, segs;
+	bool en_rel_wr = card->ext_csd.rel_param & EXT_CSD_WR_REL_PARAM_EN;
+
+	if (!(md->flags & MMC_BLK_PACKED_CMD) || rq_data_dir(req) != WRITE)
+		return 0;
 
-		if (rq_data_dir(req) == WRITE)
-			mmc_adjust_toshiba_write(card, &brq.mrq);
+	/* Legacy reliable writes have their own size rules. */
+	if (mmc_blk_rel_wr(md, req) && !en_rel_wr)
+		return 0;
 
-		mmc_set_data_timeout(&brq.data, card);
+	max_num = min_t(unsigned int, card->ext_csd.max_packed_writes,
+			MMC_PACKED_MAX);
+	max_blocks = min(host->max_blk_count, host->max_req_size >> 9);
+	max_blocks = min(max_blocks, 0xffffU);
+	if (mqrq->bounce_buf)
+		max_blocks = min(max_blocks, mq->bouncesz >> 9);
+	max_segs = min(host->max_hw_segs, host->max_phys_segs);
+
+	/* One block and one segment for the header */
+	blocks = 1 + blk_rq_sectors(req);
+	segs = 1 + req->nr_phys_segments;
+	if (blocks > max_blocks || segs > max_segs)
+		return 0;
 
-		brq.data.sg = mq->sg;
-		brq.data.sg_len = mmc_queue_map_sg(mq);
+	list_add_tail(&req->queuelist, &mqrq->packed_list);
+	num = 1;
 
-		/*
-		 * Adjust the sg list so it is the same size as the
-		 * request.
-		 */
-		if (brq.data.blocks != blk_rq_sectors(req)) {
-			int i, data_size = brq.data.blocks << 9;
-			struct scatterlist *sg;
-
-			for_each_sg(brq.data.sg, sg, brq.data.sg_len, i) {
-				data_size -= sg->length;
-				if (data_size <= 0) {
-					sg->length += data_size;
-					i++;
-					break;
-				}
-			}
-			brq.data.sg_len = i;
-		}
+	spin_lock_irq(q->queue_lock);
+	while (num < max_num) {
+		next = blk_peek_request(q);
+		if (!next)
+			break;
 
-		mmc_queue_bounce_pre(mq);
+		if (blk_discard_rq(next) || rq_data_dir(next) != WRITE)
+			break;
 
-		/*
-		 * Try the workaround first for writes, then fall back.
-		 */
-		if (rq_data_dir(req) != WRITE || disable_multi ||
-		    !mmc_handle_toshiba_write(mq, card, &brq.mrq))
-			mmc_wait_for_req(card->host, &brq.mrq);
+		if (mmc_blk_rel_wr(md, next) && !en_rel_wr)
+			break;
 
-		mmc_queue_bounce_post(mq);
+		if (blocks + blk_rq_sectors(next) > max_blocks ||
+		    segs + next->nr_phys_segments > max_segs)
+			break;
 
-		ret = 0;
-		*bytes_xfered = brq.data.bytes_xfered;
-		/*
-		 * Check for errors here, but don't jump to cmd_err
-		 * until later as we need to wait for the card to leave
-		 * programming mode even when things go wrong.
+		blk_start_request(next);
+		list_add_tail(&next->queuelist, &mqrq->packed_list);
+		blocks += blk_rq_sectors(next);
+		segs += next->nr_phys_segments;
+		num++;
+	}
+	spin_unlock_irq(q->queue_lock);
+
+	if (num == 1) {
+		list_del_init(&req->queuelist);
+		return 0;
+	}
+
+	list_for_each_entry(next, &mqrq->packed_list, queuelist)
+		mmc_blk_discard_cancel(md, blk_rq_pos(next),
+				       blk_rq_sectors(next));
+
+	mqrq->packed_num = num;
+	mqrq->packed_blocks = blocks - 1;
+
+	return num;
+}
+
+static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
+			       struct mmc_card *card,
+			       int disable_multi,
+			       struct mmc_queue *mq)
+{
+	u32 readcmd, writecmd;
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	bool do_rel_wr;
+
+	if (mqrq->packed_num) {
+		mmc_blk_packed_hdr_wrq_prep(mqrq, card, mq);
+		return;
+	}
+
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+	brq->data.blksz = 512;
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+	brq->data.blocks = blk_rq_sectors(req);
+
+	/*
+	 * The block layer doesn't support all sector count
+	 * restrictions, so we need to be prepared for too big
+	 * requests.
+	 */
+	if (brq->data.blocks > card->host->max_blk_count)
+		brq->data.blocks = card->host->max_blk_count;
+
+	/*
+	 * After a read error, we redo the request one sector at a time
+	 * in order to accurately determine which sectors can be read
+	 * successfully.
+	 */
+	if (disable_multi && brq->data.blocks > 1)
+		brq->data.blocks = 1;
+
+	do_rel_wr = mmc_blk_rel_wr(md, req);
+	if (do_rel_wr)
+		mmc_blk_apply_rel_wr(brq, card, req);
+
+	/* A reliable write needs CMD23, so it is multi-block even if short */
+	if (brq->data.blocks > 1 || do_rel_wr) {
+		/* SPI multiblock writes terminate using a special
+		 * token, not a STOP_TRANSMISSION request.
 		 */
-		if (brq.cmd.error || brq.data.error || brq.stop.error) {
-			if (brq.data.blocks > 1 && rq_data_dir(req) == READ) {
-				/* Redo read one sector at a time */
-				printk(KERN_WARNING "%s: retrying using single "
-				       "block read\n", req->rq_disk->disk_name);
-				disable_multi = 1;
-				retry = 1;
-				continue;
+		if (!mmc_host_is_spi(card->host)
+				|| rq_data_dir(req) == READ)
+			brq->mrq.stop = &brq->stop;
+		readcmd = MMC_READ_MULTIPLE_BLOCK;
+		writecmd = MMC_WRITE_MULTIPLE_BLOCK;
+	} else {
+		brq->mrq.stop = NULL;
+		readcmd = MMC_READ_SINGLE_BLOCK;
+		writecmd = MMC_WRITE_BLOCK;
+	}
+
+	if (rq_data_dir(req) == READ) {
+		brq->cmd.opcode = readcmd;
+		brq->data.flags |= MMC_DATA_READ;
+	} else {
+		brq->cmd.opcode = writecmd;
+		brq->data.flags |= MMC_DATA_WRITE;
+	}
+
+	if (rq_data_dir(req) == WRITE)
+		mmc_adjust_toshiba_write(card, &brq->mrq);
+
+	mmc_set_data_timeout(&brq->data, card);
+
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
+
+	/*
+	 * A bounced request can't be larger than the bounce buffer;
+	 * the rest of it goes out in a follow-up transfer.
+	 */
+	if (mqrq->bounce_sg_len &&
+	    brq->data.blocks > (mqrq->sg[0].length >> 9))
+		brq->data.blocks = mqrq->sg[0].length >> 9;
+
+	/*
+	 * Adjust the sg list so it is the same size as the
+	 * request.
+	 */
+	if (brq->data.blocks != blk_rq_sectors(req)) {
+		int i, data_size = brq->data.blocks << 9;
+		struct scatterlist *sg;
+
+		for_each_sg(brq->data.sg, sg, brq->data.sg_len, i) {
+			data_size -= sg->length;
+			if (data_size <= 0) {
+				sg->length += data_size;
+				i++;
+				break;
 			}
-			status = get_card_status(card, req);
-		} else if (disable_multi == 1) {
-			disable_multi = 0;
-			printk(KERN_INFO "%s: multi block enabled\n",
-				req->rq_disk->disk_name);
-		}
-		retry = 0;
-
-		if (brq.cmd.error) {
-			ret = brq.cmd.error;
-			printk(KERN_ERR "%s: error %d sending read/write "
-			       "command, response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.cmd.error,
-			       brq.cmd.resp[0], status);
 		}
+		brq->data.sg_len = i;
+	}
 
-		if (brq.data.error) {
-			ret = brq.data.error;
-			if (brq.data.error == -ETIMEDOUT && brq.mrq.stop)
-				/* 'Stop' response contains card status */
-				status = brq.mrq.stop->resp[0];
-			printk(KERN_ERR "%s: error %d transferring data,"
-			       " sector %u, nr %u, card status %#x\n",
-			       req->rq_disk->disk_name, brq.data.error,
-			       (unsigned)blk_rq_pos(req),
-			       (unsigned)blk_rq_sectors(req), status);
-		}
+	/*
+	 * With the block count set up front the card ends the transfer
+	 * by itself, saving the stop command; it is also the only way to
+	 * ask for a reliable write.
+	 */
+	if ((md->flags & MMC_BLK_CMD23) &&
+	    (brq->data.blocks > 1 || do_rel_wr)) {
+		brq->sbc.opcode = MMC_SET_BLOCK_COUNT;
+		brq->sbc.arg = brq->data.blocks;
+		if (do_rel_wr)
+			brq->sbc.arg |= MMC_CMD23_ARG_REL_WR;
+		brq->sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+		brq->mrq.sbc = &brq->sbc;
+	}
 
-		if (brq.stop.error) {
-			ret = brq.stop.error;
-			printk(KERN_ERR "%s: error %d sending stop command, "
-			       "response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.stop.error,
-			       brq.stop.resp[0], status);
-		}
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_err_check;
 
-		/*
-		* We need to wait for the card to leave programming mode
-		* even when things go wrong.
-		*/
-		if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ) {
-			do {
-				int err;
-				cmd.opcode = MMC_SEND_STATUS;
-				cmd.arg = card->rca << 16;
-				cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
-				err = mmc_wait_for_cmd(card->host, &cmd, 5);
-				if (err) {
-					printk(KERN_ERR "%s: error %d requesting status\n",
-					       req->rq_disk->disk_name, err);
-					ret = err;
-					break;
-				}
-				/*
-				 * Some cards mishandle the status bits,
-				 * so make sure to check both the busy
-				 * indication and the card state.
-				 */
-			} while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
-				(R1_CURRENT_STATE(cmd.resp[0]) == 7));
-		}
+	mmc_queue_bounce_pre(mqrq);
+}
+
+/*
+ * Complete the requests of a packed write that made it to the card.
+ * Whatever is left is unpacked: the first of it becomes @mqrq's request
+ * and the rest wait on the packed list to be sent one at a time.
+ */
+static int mmc_blk_packed_rq_done(struct mmc_blk_data *md,
+				  struct mmc_queue_req *mqrq, int status)
+{
+	struct request *prq;
+	unsigned int idx = 0;
+
+	spin_lock_irq(&md->lock);
+	while (!list_empty(&mqrq->packed_list)) {
+		if (status != MMC_BLK_SUCCESS && idx == mqrq->packed_fail_idx)
+			break;
+		prq = list_first_entry(&mqrq->packed_list, struct request,
+				       queuelist);
+		list_del_init(&prq->queuelist);
+		__blk_end_request_all(prq, 0);
+		idx++;
+	}
+	spin_unlock_irq(&md->lock);
+
+	mqrq->packed_num = 0;
+	if (list_empty(&mqrq->packed_list))
+		return 0;
+
+	mqrq->req = list_first_entry(&mqrq->packed_list, struct request,
+				     queuelist);
+	list_del_init(&mqrq->req->queuelist);
+
+	printk(KERN_WARNING "%s: packed write failed at entry %u, "
+	       "retrying the rest unpacked\n",
+	       mqrq->req->rq_disk->disk_name, idx);
+
+	return 1;
+}
+
+/*
+ * Account for a finished transfer of @mqrq.  Returns non-zero if part of
+ * the request is still outstanding and has to be sent again.
+ */
+static int mmc_blk_rw_rq_done(struct mmc_blk_data *md,
+			      struct mmc_queue_req *mqrq, int status,
+			      int *disable_multi)
+{
+	struct request *req = mqrq->req;
+	int ret;
+
+	mmc_queue_bounce_post(mqrq);
+
+	if (mqrq->packed_num)
+		return mmc_blk_packed_rq_done(md, mqrq, status);
+
+	if (status == MMC_BLK_RETRY_SINGLE) {
+		*disable_multi = 1;
+		return 1;
+	}
 
+	/*
+	 * First handle the sectors that got transferred
+	 * successfully...
+	 */
+	spin_lock_irq(&md->lock);
+	ret = __blk_end_request(req, 0, mqrq->brq.data.bytes_xfered);
+	spin_unlock_irq(&md->lock);
+
+	/*
+	 * ...then check if things went south.
+	 */
+	if (status == MMC_BLK_CMD_ERR) {
 		/*
-		 * Adjust the number of bytes transferred if there has been
-		 * an error...
+		 * Kill of the rest of the request...
 		 */
-		if (ret) {
-			/*
-			 * For reads we just fail the entire chunk as that
-			 * should be safe in all cases.
-			 *
-			 * If this is an SD card and we're writing, we can ask
-			 * the card for known good sectors.
-			 *
-			 * If the card is not SD, we can still ok written
-			 * sectors as reported by the controller (which might
-			 * be less than the real number of written sectors, but
-			 * never more).
-			 */
-			if (rq_data_dir(req) == READ)
-				*bytes_xfered = 0;
-			else if (mmc_card_sd(card)) {
-				u32 blocks = mmc_sd_num_wr_blocks(card);
-				if (blocks == (u32)-1)
-					*bytes_xfered = 0;
-				else
-					*bytes_xfered = blocks << 9;
-			}
-		}
-	} while (retry);
+		spin_lock_irq(&md->lock);
+		while (ret)
+			ret = __blk_end_request(req, -EIO,
+				blk_rq_cur_bytes(req));
+		spin_unlock_irq(&md->lock);
+	} else if (*disable_multi) {
+		*disable_multi = 0;
+		printk(KERN_INFO "%s: multi block enabled\n",
+			req->rq_disk->disk_name);
+	}
 
 	return ret;
 }
 
-static int mmc_blk_erase_rq(struct mmc_blk_data *md,
-	struct request *req, unsigned int *bytes_xfered)
+/*
+ * Account for the completion of @mq_rq and resend whatever part of it
+ * is still outstanding, including the leftovers of a failed packed
+ * write.  Nothing else is on the bus while this runs.
+ */
+static void mmc_blk_rw_rq_finish(struct mmc_queue *mq,
+				 struct mmc_queue_req *mq_rq, int status)
 {
-	struct mmc_card *card;
-	struct mmc_command cmd;
-	int ret;
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	int disable_multi = 0;
 
-	uint64_t start, end, blocks;
+	for (;;) {
+		if (!mmc_blk_rw_rq_done(md, mq_rq, status, &disable_multi)) {
+			if (list_empty(&mq_rq->packed_list))
+				break;
+			mq_rq->req = list_first_entry(&mq_rq->packed_list,
+						      struct request,
+						      queuelist);
+			list_del_init(&mq_rq->req->queuelist);
+		}
+		mmc_blk_rw_rq_prep(mq_rq, card, disable_multi, mq);
+		mmc_start_req(card->host, &mq_rq->mmc_active, NULL);
+		mmc_start_req(card->host, NULL, &status);
+	}
+}
 
-	BUG_ON(!bytes_xfered);
+/*
+ * Issue @rqc and complete the request that was in flight before it.
+ *
+ * The new request is prepared (sg list, bounce copy, host DMA mapping)
+ * while the previous one is still on the bus, and is started as soon as
+ * the previous one has completed without error.  With @rqc == NULL only
+ * the outstanding request is waited for.
+ */
+static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_queue_req *mq_rq;
+	struct mmc_async_req *areq;
+	int status;
 
-	*bytes_xfered = 0;
+	if (!rqc && !mq->mqrq_prev->req)
+		return 0;
+
+	if (rqc && mmc_blk_toshiba_sync(md, rqc)) {
+		/* Drain the bus, then run this one on its own. */
+		if (card->host->areq)
+			mmc_blk_issue_rw_rq(mq, NULL);
+
+		mq_rq = mq->mqrq_cur;
+		mmc_blk_rw_rq_prep(mq_rq, card, 0, mq);
+		if (mmc_handle_toshiba_write(mq, card, &mq_rq->brq.mrq)) {
+			status = mmc_blk_err_check(card, &mq_rq->mmc_active);
+			mmc_blk_rw_rq_finish(mq, mq_rq, status);
+			return 1;
+		}
+	}
 
-	card = md->queue.card;
+	if (rqc)
+		mmc_blk_prep_packed_list(mq, rqc);
 
-	BUG_ON(mmc_card_blockaddr(card) && (card->csd.erase_size % 512));
+	do {
+		if (rqc) {
+			mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
+			areq = &mq->mqrq_cur->mmc_active;
+		} else
+			areq = NULL;
 
-	start = ((uint64_t)blk_rq_pos(req)) << 9;
-	end = start + (((uint64_t)blk_rq_sectors(req)) << 9);
+		areq = mmc_start_req(card->host, areq, &status);
+		if (!areq)
+			return 1;
 
-	/*
-	 * The specs talk about the card removing the least
-	 * significant bits, but the erase sizes are not guaranteed
-	 * to be a power of two, so do a proper calculation.
-	 */
-	blocks = start;
-	if (do_div(blocks, card->csd.erase_size)) /* start % erase_size */
-		start = (blocks + 1) * card->csd.erase_size; /* roundup() */
-	blocks = end;
-	if (do_div(blocks, card->csd.erase_size))
-		end = blocks * card->csd.erase_size;
-
-	if (start == end)
-		goto out;
+		mq_rq = container_of(areq, struct mmc_queue_req, mmc_active);
+		mmc_blk_rw_rq_finish(mq, mq_rq, status);
+
+		/*
+		 * mmc_start_req() only starts the new request if the
+		 * previous one completed cleanly; otherwise go round
+		 * again and start it on an idle bus.
+		 */
+	} while (rqc && status != MMC_BLK_SUCCESS);
+
+	return 1;
+}
+
+/*
+ * Erase @nr sectors from @from.  The caller has done any alignment the
+ * erase type needs.
+ */
+static int mmc_blk_erase(struct mmc_blk_data *md, sector_t from, sector_t nr,
+			 u32 arg)
+{
+	struct mmc_card *card = md->queue.card;
+	struct mmc_command cmd;
+	u64 start = from, end = from + nr;
+	int ret;
 
 	/*
 	 * The MMC spec isn't entirely clear that this should be done,
 	 * but it would be impossible to erase the entire card if the
 	 * addresses aren't sector based.
 	 */
-	if (mmc_card_blockaddr(card)) {
-		start >>= 9;
-		end >>= 9;
+	if (!mmc_card_blockaddr(card)) {
+		start <<= 9;
+		end <<= 9;
 	}
 
 	if (mmc_card_sd(card))
@@ -703,7 +1232,7 @@ static int mmc_blk_erase_rq(struct mmc_blk_data *md,
 	ret = mmc_wait_for_cmd(card->host, &cmd, 0);
 	if (ret) {
 		printk(KERN_ERR "%s: error %d setting block erase start address\n",
-		       req->rq_disk->disk_name, ret);
+		       md->disk->disk_name, ret);
 		return ret;
 	}
 
@@ -717,18 +1246,18 @@ static int mmc_blk_erase_rq(struct mmc_blk_data *md,
 	ret = mmc_wait_for_cmd(card->host, &cmd, 0);
 	if (ret) {
 		printk(KERN_ERR "%s: error %d setting block erase end address\n",
-		       req->rq_disk->disk_name, ret);
+		       md->disk->disk_name, ret);
 		return ret;
 	}
 
 	cmd.opcode = MMC_ERASE;
-	cmd.arg = 0;	/* was MMC_ERASE_TYPE_SECURE */
+	cmd.arg = arg;
 	cmd.flags = MMC_RSP_R1B | MMC_CMD_AC;
 
 	ret = mmc_wait_for_cmd(card->host, &cmd, 0);
 	if (ret) {
 		printk(KERN_ERR "%s: error %d starting block erase\n",
-		       req->rq_disk->disk_name, ret);
+		       md->disk->disk_name, ret);
 		return ret;
 	}
 
@@ -743,7 +1272,7 @@ static int mmc_blk_erase_rq(struct mmc_blk_data *md,
 			ret = mmc_wait_for_cmd(card->host, &cmd, 5);
 			if (ret) {
 				printk(KERN_ERR "%s: error %d requesting status\n",
-				       req->rq_disk->disk_name, ret);
+				       md->disk->disk_name, ret);
 				return ret;
 			}
 			/*
@@ -755,56 +1284,130 @@ static int mmc_blk_erase_rq(struct mmc_blk_data *md,
 			(R1_CURRENT_STATE(cmd.resp[0]) == 7));
 	}
 
-out:
-	*bytes_xfered = blk_rq_sectors(req) << 9;
-
 	return 0;
 }
 
-static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
+static inline int mmc_blk_can_trim(struct mmc_card *card)
+{
+	return mmc_card_mmc(card) &&
+	       (card->ext_csd.sec_feature_support & EXT_CSD_SEC_GB_CL_EN);
+}
+
+/*
+ * Called from the queue thread when there is nothing else to do: erase
+ * the next chunk of discarded sectors.  Whole erase groups are erased;
+ * what is left over is trimmed if the card can, and dropped otherwise.
+ */
+static long mmc_blk_idle(struct mmc_queue *mq)
 {
 	struct mmc_blk_data *md = mq->data;
 	struct mmc_card *card = md->queue.card;
-	int ret, err, bytes_xfered;
+	struct mmc_blk_discard *d;
+	unsigned int eg, chunk;
+	sector_t from, end, tmp;
+	u32 arg = 0;
+	int err;
 
-	mmc_claim_host(card->host);
+	if (list_empty(&md->discards))
+		return 0;
 
-	do {
-		if (blk_discard_rq(req))
-			err = mmc_blk_erase_rq(md, req, &bytes_xfered);
-		else
-			err = mmc_blk_xfer_rq(md, req, &bytes_xfered);
+#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
+	/* Not worth waking the card up for */
+	if (mmc_bus_needs_resume(card->host))
+		return 0;
+#endif
 
-		/*
-		 * First handle the sectors that got transferred
-		 * successfully...
-		 */
-		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, bytes_xfered);
-		spin_unlock_irq(&md->lock);
+	if (time_before(jiffies, md->discard_stamp + MMC_BLK_DISCARD_DELAY))
+		return md->discard_stamp + MMC_BLK_DISCARD_DELAY - jiffies;
 
-		/*
-		 * ...then check if things went south.
-		 */
-		if (err) {
-			mmc_release_host(card->host);
+	eg = max(card->csd.erase_size >> 9, 1U);
+	chunk = MMC_BLK_ERASE_CHUNK;
+	if (eg >= chunk)
+		chunk = eg;
+	else
+		chunk -= chunk % eg;
+
+	d = list_first_entry(&md->discards, struct mmc_blk_discard, list);
+
+	tmp = d->from;
+	from = d->from;
+	if (sector_div(tmp, eg))
+		from = (tmp + 1) * eg;
+	tmp = d->from + d->nr;
+	end = d->from + d->nr;
+	if (sector_div(tmp, eg))
+		end = tmp * eg;
+
+	if (from < end) {
+		if (end - from > chunk)
+			end = from + chunk;
+	} else if (mmc_blk_can_trim(card)) {
+		from = d->from;
+		end = from + min_t(sector_t, d->nr, chunk);
+		arg = MMC_ERASE_TYPE_TRIM;
+	} else {
+		list_del(&d->list);
+		md->nr_discards--;
+		kfree(d);
+		return 1;
+	}
 
-			/*
-			 * Kill of the rest of the request...
-			 */
-			spin_lock_irq(&md->lock);
-			while (ret)
-				ret = __blk_end_request(req, -EIO,
-					blk_rq_cur_bytes(req));
-			spin_unlock_irq(&md->lock);
+	mmc_claim_host(card->host);
+	err = mmc_blk_erase(md, from, end - from, arg);
+	mmc_release_host(card->host);
+
+	if (err)
+		mmc_blk_discard_cancel(md, d->from, d->nr);
+	else
+		mmc_blk_discard_cancel(md, from, end - from);
+
+	return 1;
+}
+
+static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	int ret;
 
-			return 0;
+	/*
+	 * The host stays claimed for as long as requests keep coming
+	 * back to back; it is released once the queue runs dry.
+	 */
+	if (req && !mq->mqrq_prev->req) {
+		mmc_claim_host(card->host);
+#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
+		if (mmc_bus_needs_resume(card->host)) {
+			mmc_resume_bus(card->host);
+			mmc_blk_set_blksize(md, card);
 		}
-	} while (ret);
+#endif
+	}
 
-	mmc_release_host(card->host);
+	if (req && blk_discard_rq(req)) {
+		/* complete ongoing async transfer before queueing discard */
+		if (card->host->areq)
+			mmc_blk_issue_rw_rq(mq, NULL);
 
-	return 1;
+		mmc_blk_discard_add(md, blk_rq_pos(req), blk_rq_sectors(req));
+
+		spin_lock_irq(&md->lock);
+		__blk_end_request_all(req, 0);
+		spin_unlock_irq(&md->lock);
+
+		ret = 1;
+	} else {
+		if (req && rq_data_dir(req) == WRITE)
+			mmc_blk_discard_cancel(md, blk_rq_pos(req),
+					       blk_rq_sectors(req));
+		ret = mmc_blk_issue_rw_rq(mq, req);
+	}
+
+	if (!req)
+		/* release host only when there are no more requests */
+		mmc_release_host(card->host);
+
+	return ret;
 }
 
 
@@ -865,6 +1468,18 @@ static struct mmc_blk_data *mmc_blk_alloc(struct mmc_card *card)
 	 */
 	md->read_only = mmc_blk_readonly(card);
 
+	/* Only use SET_BLOCK_COUNT on eMMC 4.3 and later */
+	if (mmc_card_mmc(card) && mmc_host_cmd23(card->host) &&
+	    card->csd.mmca_vsn >= CSD_SPEC_VER_3 &&
+	    card->ext_csd.rev >= 3) {
+		md->flags |= MMC_BLK_CMD23;
+		if (card->ext_csd.rel_wr_sec_c)
+			md->flags |= MMC_BLK_REL_WR;
+		/* The Toshiba workaround relies on seeing every write. */
+		if (card->ext_csd.packed_event_en && !md->bounce)
+			md->flags |= MMC_BLK_PACKED_CMD;
+	}
+
 	md->disk = alloc_disk(1 << MMC_SHIFT);
 	if (md->disk == NULL) {
 		ret = -ENOMEM;
@@ -872,6 +1487,7 @@ static struct mmc_blk_data *mmc_blk_alloc(struct mmc_card *card)
 	}
 
 	spin_lock_init(&md->lock);
+	INIT_LIST_HEAD(&md->discards);
 	md->usage = 1;
 
 	ret = mmc_init_queue(&md->queue, card, &md->lock);
@@ -879,6 +1495,7 @@ static struct mmc_blk_data *mmc_blk_alloc(struct mmc_card *card)
 		goto err_putdisk;
 
 	md->queue.issue_fn = mmc_blk_issue_rq;
+	md->queue.idle_fn = mmc_blk_idle;
 	md->queue.data = md;
 
 	md->disk->major	= MMC_BLOCK_MAJOR;
@@ -930,6 +1547,30 @@ static struct mmc_blk_data *mmc_blk_alloc(struct mmc_card *card)
 	return ERR_PTR(ret);
 }
 
+static ssize_t mmc_blk_bounce_stats_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	struct mmc_queue_stats *stats;
+	ssize_t ret;
+
+	if (!md)
+		return -ENODEV;
+
+	stats = &md->queue.stats;
+	ret = sprintf(buf, "%lu %llu %lu %llu\n",
+		stats->direct_reqs,
+		(unsigned long long)stats->direct_bytes,
+		stats->bounce_reqs,
+		(unsigned long long)stats->bounce_bytes);
+
+	mmc_blk_put(md);
+
+	return ret;
+}
+
+static DEVICE_ATTR(bounce_stats, S_IRUGO, mmc_blk_bounce_stats_show, NULL);
+
 #if defined(CONFIG_MACH_MOT) && defined(CONFIG_APANIC_MMC)
 static int mmc_apanic_annotate(struct mmc_blk_data *md, struct mmc_card *card)
 {
@@ -1002,6 +1643,10 @@ static int mmc_blk_probe(struct mmc_card *card)
 	mmc_set_bus_resume_policy(card->host, 1);
 #endif
 	add_disk(md->disk);
+
+	if (device_create_file(disk_to_dev(md->disk), &dev_attr_bounce_stats))
+		printk(KERN_WARNING "%s: unable to create bounce_stats\n",
+			md->disk->disk_name);
 	return 0;
 
  out:
@@ -1016,6 +1661,9 @@ static void mmc_blk_remove(struct mmc_card *card)
 	struct mmc_blk_data *md = mmc_get_drvdata(card);
 
 	if (md) {
+		device_remove_file(disk_to_dev(md->disk),
+				   &dev_attr_bounce_stats);
+
 		/* Stop new requests from getting into the queue */
 		del_gendisk(md->disk);
 
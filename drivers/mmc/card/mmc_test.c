@@ -13,8 +13,12 @@
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
 #include <linux/mmc/mmc.h>
+#include <linux/mmc/sd.h>
 
 #include <linux/scatterlist.h>
+#include <linux/random.h>
+#include <linux/time.h>
+#include <linux/math64.h>
 
 #define RESULT_OK		0
 #define RESULT_FAIL		1
@@ -24,6 +28,47 @@
 #define BUFFER_ORDER		2
 #define BUFFER_SIZE		(PAGE_SIZE << BUFFER_ORDER)
 
+/* Size of the area used by the performance tests, and of one transfer */
+#define TEST_AREA_SIZE		(4 * 1024 * 1024)
+#define TEST_AREA_CHUNK		(64 * 1024)
+
+/* Size of the small random writes, and the most packed into one command */
+#define TEST_SMALL_WRITE	4096
+#define TEST_PACKED_MAX		(TEST_AREA_CHUNK / TEST_SMALL_WRITE)
+
+/**
+ * struct mmc_test_async_req - one transfer of a performance test
+ * @areq: handed to mmc_start_req()
+ * @test: owning test card
+ */
+struct mmc_test_async_req {
+	struct mmc_async_req	areq;
+	struct mmc_test_card	*test;
+
+	struct mmc_request	mrq;
+	struct mmc_command	cmd;
+	struct mmc_command	stop;
+	struct mmc_data		data;
+	struct scatterlist	sg;
+};
+
+/**
+ * struct mmc_test_area - area on the card used by the performance tests
+ * @dev_addr: first sector of the area
+ * @chunk: bytes moved by each request
+ * @order: page order of each transfer buffer
+ * @pages: two transfer buffers, so that one can be prepared while the
+ *         other is in flight
+ * @req: the two requests using those buffers
+ */
+struct mmc_test_area {
+	unsigned int		dev_addr;
+	unsigned int		chunk;
+	unsigned int		order;
+	struct page		*pages[2];
+	struct mmc_test_async_req req[2];
+};
+
 struct mmc_test_card {
 	struct mmc_card	*card;
 
@@ -32,6 +77,7 @@ struct mmc_test_card {
 #ifdef CONFIG_HIGHMEM
 	struct page	*highmem;
 #endif
+	struct mmc_test_area area;
 };
 
 /*******************************************************************/
@@ -261,6 +307,8 @@ static int mmc_test_check_result(struct mmc_test_card *test,
 
 	ret = 0;
 
+	if (!ret && mrq->sbc && mrq->sbc->error)
+		ret = mrq->sbc->error;
 	if (!ret && mrq->cmd->error)
 		ret = mrq->cmd->error;
 	if (!ret && mrq->data->error)
@@ -803,6 +851,437 @@ static int mmc_test_multi_xfersize_read(struct mmc_test_card *test)
 	return 0;
 }
 
+/*******************************************************************/
+/*  Performance tests                                              */
+/*******************************************************************/
+
+static unsigned int mmc_test_capacity(struct mmc_card *card)
+{
+	if (!mmc_card_sd(card) && mmc_card_blockaddr(card))
+		return card->ext_csd.sectors;
+	else
+		return card->csd.capacity << (card->csd.read_blkbits - 9);
+}
+
+static int mmc_test_area_cleanup(struct mmc_test_card *test)
+{
+	struct mmc_test_area *t = &test->area;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(t->pages); i++) {
+		if (t->pages[i])
+			__free_pages(t->pages[i], t->order);
+		t->pages[i] = NULL;
+	}
+
+	return 0;
+}
+
+/*
+ * Allocate the transfer buffers and pick an area in the middle of the
+ * card, away from the partition table and the first test sectors.
+ */
+static int mmc_test_area_prepare(struct mmc_test_card *test)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_host *host = test->card->host;
+	unsigned int chunk, sectors;
+	int i, ret;
+
+	ret = mmc_test_set_blksize(test, 512);
+	if (ret)
+		return ret;
+
+	chunk = TEST_AREA_CHUNK;
+	chunk = min(chunk, host->max_req_size);
+	chunk = min(chunk, host->max_seg_size);
+	chunk = min(chunk, host->max_blk_count * 512);
+	chunk &= ~511;
+	if (!chunk)
+		return -EINVAL;
+
+	sectors = mmc_test_capacity(test->card);
+	if (sectors < 2 * (TEST_AREA_SIZE >> 9))
+		return -EINVAL;
+
+	memset(t, 0, sizeof(struct mmc_test_area));
+	t->chunk = chunk;
+	t->order = get_order(chunk);
+	t->dev_addr = (sectors / 2) & ~((TEST_AREA_SIZE >> 9) - 1);
+
+	for (i = 0; i < ARRAY_SIZE(t->pages); i++) {
+		t->pages[i] = alloc_pages(GFP_KERNEL, t->order);
+		if (!t->pages[i]) {
+			mmc_test_area_cleanup(test);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+static int mmc_test_async_check(struct mmc_card *card,
+	struct mmc_async_req *areq)
+{
+	struct mmc_test_async_req *rq =
+		container_of(areq, struct mmc_test_async_req, areq);
+
+	mmc_test_wait_busy(rq->test);
+
+	return mmc_test_check_result(rq->test, &rq->mrq);
+}
+
+static void mmc_test_prepare_async_req(struct mmc_test_card *test,
+	struct mmc_test_async_req *rq, struct page *page,
+	unsigned int dev_addr, int write)
+{
+	struct mmc_test_area *t = &test->area;
+
+	memset(rq, 0, sizeof(struct mmc_test_async_req));
+
+	rq->test = test;
+	rq->mrq.cmd = &rq->cmd;
+	rq->mrq.data = &rq->data;
+	rq->mrq.stop = &rq->stop;
+
+	sg_init_table(&rq->sg, 1);
+	sg_set_page(&rq->sg, page, t->chunk, 0);
+
+	if (!mmc_card_blockaddr(test->card))
+		dev_addr <<= 9;
+
+	mmc_test_prepare_mrq(test, &rq->mrq, &rq->sg, 1, dev_addr,
+		t->chunk / 512, 512, write);
+
+	rq->areq.mrq = &rq->mrq;
+	rq->areq.err_check = mmc_test_async_check;
+}
+
+static void mmc_test_print_rate(struct mmc_test_card *test, const char *what,
+	unsigned int count, unsigned int chunk, struct timespec *ts1,
+	struct timespec *ts2)
+{
+	struct timespec ts = timespec_sub(*ts2, *ts1);
+	u64 ns = timespec_to_ns(&ts);
+	u64 bytes = (u64)count * chunk;
+	unsigned int rate = 0;
+
+	if (ns)
+		rate = div64_u64(bytes * NSEC_PER_SEC, ns) >> 10;
+
+	printk(KERN_INFO "%s: %s: %u x %u bytes took %lu.%09lu seconds "
+		"(%u KiB/s, %u IOPS)\n", mmc_hostname(test->card->host), what,
+		count, chunk, ts.tv_sec, ts.tv_nsec, rate,
+		ns ? (unsigned int)div64_u64((u64)count * NSEC_PER_SEC, ns) : 0);
+}
+
+/*
+ * Move the whole test area through the card in chunk sized requests,
+ * either sequentially or in random order.  In non-blocking mode the
+ * next request is prepared by the host while the current one is being
+ * transferred, which is what the block driver does.
+ */
+static int mmc_test_area_perf(struct mmc_test_card *test, int write,
+	int random, int nonblock)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_host *host = test->card->host;
+	struct mmc_test_async_req *rq;
+	struct mmc_async_req *done;
+	unsigned int i, cnt, addr;
+	struct timespec ts1, ts2;
+	int ret = 0;
+
+	cnt = TEST_AREA_SIZE / t->chunk;
+
+	getnstimeofday(&ts1);
+	for (i = 0; i < cnt; i++) {
+		if (random)
+			addr = (random32() % cnt) * (t->chunk >> 9);
+		else
+			addr = i * (t->chunk >> 9);
+
+		rq = &t->req[i & 1];
+		mmc_test_prepare_async_req(test, rq, t->pages[i & 1],
+			t->dev_addr + addr, write);
+
+		if (nonblock) {
+			done = mmc_start_req(host, &rq->areq, &ret);
+			if (done && ret)
+				break;
+		} else {
+			mmc_wait_for_req(host, &rq->mrq);
+			ret = mmc_test_async_check(test->card, &rq->areq);
+			if (ret)
+				break;
+		}
+	}
+	if (nonblock) {
+		int err;
+
+		mmc_start_req(host, NULL, &err);
+		if (!ret)
+			ret = err;
+	}
+	getnstimeofday(&ts2);
+
+	if (ret)
+		return ret;
+
+	mmc_test_print_rate(test, nonblock ? "non-blocking" : "blocking",
+		cnt, t->chunk, &ts1, &ts2);
+
+	return 0;
+}
+
+static int mmc_test_perf_seq_write(struct mmc_test_card *test)
+{
+	return mmc_test_area_perf(test, 1, 0, 0);
+}
+
+static int mmc_test_perf_seq_write_nonblock(struct mmc_test_card *test)
+{
+	return mmc_test_area_perf(test, 1, 0, 1);
+}
+
+static int mmc_test_perf_seq_read(struct mmc_test_card *test)
+{
+	return mmc_test_area_perf(test, 0, 0, 0);
+}
+
+static int mmc_test_perf_seq_read_nonblock(struct mmc_test_card *test)
+{
+	return mmc_test_area_perf(test, 0, 0, 1);
+}
+
+static int mmc_test_perf_rnd_write(struct mmc_test_card *test)
+{
+	return mmc_test_area_perf(test, 1, 1, 0);
+}
+
+static int mmc_test_perf_rnd_write_nonblock(struct mmc_test_card *test)
+{
+	return mmc_test_area_perf(test, 1, 1, 1);
+}
+
+static int mmc_test_perf_rnd_read(struct mmc_test_card *test)
+{
+	return mmc_test_area_perf(test, 0, 1, 0);
+}
+
+static int mmc_test_perf_rnd_read_nonblock(struct mmc_test_card *test)
+{
+	return mmc_test_area_perf(test, 0, 1, 1);
+}
+
+/*
+ * Write the test area in 4 KiB pieces at random offsets.  Each piece
+ * goes out as CMD25 ended by CMD12, as CMD25 preceded by CMD23 or, with
+ * @packed, as one entry of an eMMC packed write holding as many pieces
+ * as the card and the transfer buffer allow.
+ */
+static int mmc_test_small_write_perf(struct mmc_test_card *test, int sbc,
+	int packed)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_card *card = test->card;
+	struct mmc_request mrq;
+	struct mmc_command sbc_cmd, cmd, stop;
+	struct mmc_data data;
+	struct scatterlist sg[TEST_PACKED_MAX + 1];
+	__le32 *hdr = NULL;
+	unsigned int i, j, n, cnt, sectors, max_num, blocks, sg_len;
+	unsigned int addr, first = 0;
+	struct timespec ts1, ts2;
+	int ret = 0;
+
+	if ((sbc || packed) && !mmc_host_cmd23(card->host))
+		return RESULT_UNSUP_HOST;
+
+	max_num = 1;
+	if (packed) {
+		if (!mmc_host_packed_wr(card->host))
+			return RESULT_UNSUP_HOST;
+		if (card->ext_csd.max_packed_writes < 3)
+			return RESULT_UNSUP_CARD;
+
+		max_num = min_t(unsigned int, card->ext_csd.max_packed_writes,
+			t->chunk / TEST_SMALL_WRITE);
+		max_num = min_t(unsigned int, max_num, TEST_PACKED_MAX);
+		if (!max_num)
+			return RESULT_UNSUP_HOST;
+
+		hdr = kmalloc(512, GFP_KERNEL);
+		if (!hdr)
+			return -ENOMEM;
+	}
+
+	sectors = TEST_SMALL_WRITE >> 9;
+	cnt = TEST_AREA_SIZE / TEST_SMALL_WRITE;
+
+	getnstimeofday(&ts1);
+	for (i = 0; i < cnt; i += n) {
+		n = min(max_num, cnt - i);
+
+		memset(&mrq, 0, sizeof(struct mmc_request));
+		memset(&sbc_cmd, 0, sizeof(struct mmc_command));
+		memset(&cmd, 0, sizeof(struct mmc_command));
+		memset(&stop, 0, sizeof(struct mmc_command));
+		memset(&data, 0, sizeof(struct mmc_data));
+
+		mrq.cmd = &cmd;
+		mrq.data = &data;
+		mrq.stop = &stop;
+
+		sg_len = 0;
+		sg_init_table(sg, n + (packed ? 1 : 0));
+		if (packed) {
+			memset(hdr, 0, 512);
+			hdr[0] = cpu_to_le32((n << 16) |
+				(MMC_PACKED_CMD_WR << 8) | MMC_PACKED_CMD_VER);
+			sg_set_buf(&sg[sg_len++], hdr, 512);
+		}
+
+		for (j = 0; j < n; j++) {
+			addr = t->dev_addr + (random32() % cnt) * sectors;
+			if (!mmc_card_blockaddr(card))
+				addr <<= 9;
+			if (j == 0)
+				first = addr;
+
+			if (packed) {
+				hdr[(j + 1) * 2] = cpu_to_le32(sectors);
+				hdr[(j + 1) * 2 + 1] = cpu_to_le32(addr);
+			}
+
+			sg_set_buf(&sg[sg_len++], page_address(t->pages[0]) +
+				j * TEST_SMALL_WRITE, TEST_SMALL_WRITE);
+		}
+
+		blocks = n * sectors + (packed ? 1 : 0);
+		mmc_test_prepare_mrq(test, &mrq, sg, sg_len, first, blocks,
+			512, 1);
+
+		if (sbc || packed) {
+			sbc_cmd.opcode = MMC_SET_BLOCK_COUNT;
+			sbc_cmd.arg = blocks;
+			if (packed)
+				sbc_cmd.arg |= MMC_CMD23_ARG_PACKED;
+			sbc_cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+			mrq.sbc = &sbc_cmd;
+		}
+
+		mmc_wait_for_req(card->host, &mrq);
+
+		ret = mmc_test_wait_busy(test);
+		if (!ret)
+			ret = mmc_test_check_result(test, &mrq);
+		if (ret)
+			break;
+	}
+	getnstimeofday(&ts2);
+
+	kfree(hdr);
+
+	if (ret)
+		return ret;
+
+	mmc_test_print_rate(test, packed ? "packed" : sbc ? "CMD23" : "CMD12",
+		cnt, TEST_SMALL_WRITE, &ts1, &ts2);
+
+	return 0;
+}
+
+static int mmc_test_perf_small_write(struct mmc_test_card *test)
+{
+	return mmc_test_small_write_perf(test, 0, 0);
+}
+
+static int mmc_test_perf_small_write_sbc(struct mmc_test_card *test)
+{
+	return mmc_test_small_write_perf(test, 1, 0);
+}
+
+static int mmc_test_perf_small_write_packed(struct mmc_test_card *test)
+{
+	return mmc_test_small_write_perf(test, 1, 1);
+}
+
+/*
+ * Erase the whole erase groups inside the test area.
+ */
+static int mmc_test_erase_area(struct mmc_test_card *test)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_card *card = test->card;
+	struct mmc_command cmd;
+	unsigned int eg, from, to;
+	int ret;
+
+	eg = max(card->csd.erase_size >> 9, 1U);
+	from = roundup(t->dev_addr, eg);
+	to = t->dev_addr + (TEST_AREA_SIZE >> 9);
+	to -= to % eg;
+	if (from >= to)
+		return RESULT_UNSUP_CARD;
+
+	if (!mmc_card_blockaddr(card)) {
+		from <<= 9;
+		to <<= 9;
+	}
+
+	memset(&cmd, 0, sizeof(struct mmc_command));
+	cmd.opcode = mmc_card_sd(card) ? SD_ERASE_WR_BLK_START :
+					 MMC_ERASE_GROUP_START;
+	cmd.arg = from;
+	cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+	ret = mmc_wait_for_cmd(card->host, &cmd, 0);
+	if (ret)
+		return ret;
+
+	memset(&cmd, 0, sizeof(struct mmc_command));
+	cmd.opcode = mmc_card_sd(card) ? SD_ERASE_WR_BLK_END :
+					 MMC_ERASE_GROUP_END;
+	cmd.arg = to - 1;
+	cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+	ret = mmc_wait_for_cmd(card->host, &cmd, 0);
+	if (ret)
+		return ret;
+
+	memset(&cmd, 0, sizeof(struct mmc_command));
+	cmd.opcode = MMC_ERASE;
+	cmd.flags = MMC_RSP_R1B | MMC_CMD_AC;
+	ret = mmc_wait_for_cmd(card->host, &cmd, 0);
+	if (ret)
+		return ret;
+
+	return mmc_test_wait_busy(test);
+}
+
+/*
+ * Write the test area sequentially right after erasing it, the way the
+ * block driver leaves discarded space.  Compare with the plain
+ * sequential write test, which writes over live data.
+ */
+static int mmc_test_perf_erase_write(struct mmc_test_card *test)
+{
+	struct timespec ts1, ts2;
+	int ret;
+
+	if (!(test->card->csd.cmdclass & CCC_ERASE))
+		return RESULT_UNSUP_CARD;
+
+	getnstimeofday(&ts1);
+	ret = mmc_test_erase_area(test);
+	getnstimeofday(&ts2);
+	if (ret)
+		return ret;
+
+	mmc_test_print_rate(test, "erase", 1, TEST_AREA_SIZE, &ts1, &ts2);
+
+	return mmc_test_area_perf(test, 1, 0, 1);
+}
+
 #ifdef CONFIG_HIGHMEM
 
 static int mmc_test_write_high(struct mmc_test_card *test)
@@ -1038,6 +1517,90 @@ static const struct mmc_test_case mmc_test_cases[] = {
 
 #endif /* CONFIG_HIGHMEM */
 
+	{
+		.name = "Sequential write performance (blocking)",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_seq_write,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Sequential write performance (non-blocking)",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_seq_write_nonblock,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Sequential read performance (blocking)",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_seq_read,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Sequential read performance (non-blocking)",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_seq_read_nonblock,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random write performance (blocking)",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_rnd_write,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random write performance (non-blocking)",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_rnd_write_nonblock,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random read performance (blocking)",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_rnd_read,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random read performance (non-blocking)",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_rnd_read_nonblock,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random 4 KiB write performance (CMD12)",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_small_write,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random 4 KiB write performance (CMD23)",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_small_write_sbc,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random 4 KiB write performance (packed)",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_small_write_packed,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Sequential write performance after erase",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_erase_write,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
 };
 
 static DEFINE_MUTEX(mmc_test_lock);
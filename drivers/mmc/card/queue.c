@@ -52,27 +52,70 @@ static int mmc_queue_thread(void *d)
 	down(&mq->thread_sem);
 	do {
 		struct request *req = NULL;
+		struct mmc_queue_req *tmp;
 
 		spin_lock_irq(q->queue_lock);
 		set_current_state(TASK_INTERRUPTIBLE);
 		if (!blk_queue_plugged(q))
 			req = blk_fetch_request(q);
-		mq->req = req;
+		mq->mqrq_cur->req = req;
 		spin_unlock_irq(q->queue_lock);
 
-		if (!req) {
+		if (req || mq->mqrq_prev->req) {
+			/*
+			 * Either start the new request while the previous
+			 * one is still on the bus, or, with nothing new to
+			 * do, just wait for the previous one to finish.
+			 */
+			set_current_state(TASK_RUNNING);
+			mq->issue_fn(mq, req);
+		} else {
+			long timeout = MAX_SCHEDULE_TIMEOUT;
+
 			if (kthread_should_stop()) {
 				set_current_state(TASK_RUNNING);
 				break;
 			}
+			/*
+			 * Give the card background work while the queue
+			 * is empty.  idle_fn() returns how long to wait
+			 * before it wants to run again, or 0 if it has
+			 * nothing left to do; a new request wakes us up
+			 * either way.
+			 */
+			if (mq->idle_fn) {
+				/* the erase may sleep */
+				__set_current_state(TASK_RUNNING);
+				timeout = mq->idle_fn(mq) ? : timeout;
+
+				/*
+				 * mmc_request() wakes us under queue_lock,
+				 * so a request that came in meanwhile is
+				 * either seen here or wakes us up.
+				 */
+				spin_lock_irq(q->queue_lock);
+				set_current_state(TASK_INTERRUPTIBLE);
+				if (!blk_queue_plugged(q) && blk_peek_request(q))
+					__set_current_state(TASK_RUNNING);
+				spin_unlock_irq(q->queue_lock);
+
+				/* kthread_stop() may have come during the erase */
+				if (kthread_should_stop()) {
+					__set_current_state(TASK_RUNNING);
+					break;
+				}
+			}
 			up(&mq->thread_sem);
-			schedule();
+			schedule_timeout(timeout);
 			down(&mq->thread_sem);
-			continue;
 		}
-		set_current_state(TASK_RUNNING);
 
-		mq->issue_fn(mq, req);
+		/* Current request becomes previous request and vice versa. */
+		mq->mqrq_prev->brq.mrq.data = NULL;
+		mq->mqrq_prev->req = NULL;
+		tmp = mq->mqrq_prev;
+		mq->mqrq_prev = mq->mqrq_cur;
+		mq->mqrq_cur = tmp;
 	} while (1);
 	up(&mq->thread_sem);
 
@@ -98,23 +141,59 @@ static void mmc_request(struct request_queue *q)
 		return;
 	}
 
-	if (!mq->req)
+	if (!mq->mqrq_cur->req && !mq->mqrq_prev->req)
 		wake_up_process(mq->thread);
 }
 
+static void mmc_queue_free_bufs(struct mmc_queue *mq)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+		struct mmc_queue_req *mqrq = &mq->mqrq[i];
+
+		kfree(mqrq->bounce_sg);
+		mqrq->bounce_sg = NULL;
+
+		kfree(mqrq->sg);
+		mqrq->sg = NULL;
+
+		kfree(mqrq->bounce_buf);
+		mqrq->bounce_buf = NULL;
+
+		kfree(mqrq->packed_cmd_hdr);
+		mqrq->packed_cmd_hdr = NULL;
+	}
+}
+
+static struct scatterlist *mmc_alloc_sg(int sg_len)
+{
+	struct scatterlist *sg;
+
+	sg = kmalloc(sizeof(struct scatterlist) * sg_len, GFP_KERNEL);
+	if (sg)
+		sg_init_table(sg, sg_len);
+
+	return sg;
+}
+
 /**
  * mmc_init_queue - initialise a queue structure.
  * @mq: mmc queue
  * @card: mmc card to attach this queue
  * @lock: queue lock
  *
- * Initialise a MMC card request queue.
+ * Initialise a MMC card request queue.  Two request slots are set up,
+ * each with its own scatterlist (and bounce buffer, if configured),
+ * so that the next request can be prepared and mapped while the
+ * previous one is still being transferred.
  */
 int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock)
 {
 	struct mmc_host *host = card->host;
 	u64 limit = BLK_BOUNCE_HIGH;
-	int ret;
+	unsigned int bouncesz = 0, sg_len = 0;
+	int ret, i;
 
 	if (mmc_dev(host)->dma_mask && *mmc_dev(host)->dma_mask)
 		limit = *mmc_dev(host)->dma_mask;
@@ -124,8 +203,10 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 	if (!mq->queue)
 		return -ENOMEM;
 
+	memset(&mq->mqrq, 0, sizeof(mq->mqrq));
+	mq->mqrq_cur = &mq->mqrq[0];
+	mq->mqrq_prev = &mq->mqrq[1];
 	mq->queue->queuedata = mq;
-	mq->req = NULL;
 
 	blk_queue_prep_rq(mq->queue, mmc_prep_request);
 	blk_queue_ordered(mq->queue, QUEUE_ORDERED_DRAIN, NULL);
@@ -148,68 +229,87 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 					  mq->queue);
 
 #ifdef CONFIG_MMC_BLOCK_BOUNCE
-	if (host->max_hw_segs == 1) {
-		unsigned int bouncesz;
-
-		bouncesz = MMC_QUEUE_BOUNCESZ;
-
-		if (bouncesz > host->max_req_size)
-			bouncesz = host->max_req_size;
-		if (bouncesz > host->max_seg_size)
-			bouncesz = host->max_seg_size;
-		if (bouncesz > (host->max_blk_count * 512))
-			bouncesz = host->max_blk_count * 512;
-
-		if (bouncesz > 512) {
-			mq->bounce_buf = kmalloc(bouncesz, GFP_KERNEL);
-			if (!mq->bounce_buf) {
+	/*
+	 * Requests whose segments the host can DMA directly are never
+	 * copied; the bounce buffers are only a per-request fallback for
+	 * the ones it can't (see mmc_queue_map_sg()).
+	 */
+	bouncesz = MMC_QUEUE_BOUNCESZ;
+
+	if (bouncesz > host->max_req_size)
+		bouncesz = host->max_req_size;
+	if (bouncesz > host->max_seg_size)
+		bouncesz = host->max_seg_size;
+	if (bouncesz > (host->max_blk_count * 512))
+		bouncesz = host->max_blk_count * 512;
+
+	if (bouncesz > 512) {
+		for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+			mq->mqrq[i].bounce_buf = kmalloc(bouncesz, GFP_KERNEL);
+			if (!mq->mqrq[i].bounce_buf) {
 				printk(KERN_WARNING "%s: unable to "
 					"allocate bounce buffer\n",
 					mmc_card_name(card));
+				mmc_queue_free_bufs(mq);
+				break;
 			}
 		}
+	}
 
-		if (mq->bounce_buf) {
-			blk_queue_bounce_limit(mq->queue, BLK_BOUNCE_ANY);
-			blk_queue_max_sectors(mq->queue, bouncesz / 512);
-			blk_queue_max_phys_segments(mq->queue, bouncesz / 512);
-			blk_queue_max_hw_segments(mq->queue, bouncesz / 512);
-			blk_queue_max_segment_size(mq->queue, bouncesz);
-
-			mq->sg = kmalloc(sizeof(struct scatterlist),
-				GFP_KERNEL);
-			if (!mq->sg) {
-				ret = -ENOMEM;
-				goto cleanup_queue;
-			}
-			sg_init_table(mq->sg, 1);
-
-			mq->bounce_sg = kmalloc(sizeof(struct scatterlist) *
-				bouncesz / 512, GFP_KERNEL);
-			if (!mq->bounce_sg) {
-				ret = -ENOMEM;
-				goto cleanup_queue;
-			}
-			sg_init_table(mq->bounce_sg, bouncesz / 512);
-		}
+	/*
+	 * A host that can't do scatter/gather gets requests shaped to
+	 * fit the bounce buffer, as a single segment is unlikely.
+	 */
+	if (mq->mqrq_cur->bounce_buf && host->max_hw_segs == 1) {
+		blk_queue_bounce_limit(mq->queue, BLK_BOUNCE_ANY);
+		blk_queue_max_sectors(mq->queue, bouncesz / 512);
+		blk_queue_max_phys_segments(mq->queue, bouncesz / 512);
+		blk_queue_max_hw_segments(mq->queue, bouncesz / 512);
+		blk_queue_max_segment_size(mq->queue, bouncesz);
+		sg_len = bouncesz / 512;
 	}
 #endif
 
-	if (!mq->bounce_buf) {
+	if (!sg_len) {
 		blk_queue_bounce_limit(mq->queue, limit);
 		blk_queue_max_sectors(mq->queue,
 			min(host->max_blk_count, host->max_req_size / 512));
 		blk_queue_max_phys_segments(mq->queue, host->max_phys_segs);
 		blk_queue_max_hw_segments(mq->queue, host->max_hw_segs);
 		blk_queue_max_segment_size(mq->queue, host->max_seg_size);
+		sg_len = host->max_phys_segs;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+		mq->mqrq[i].sg = mmc_alloc_sg(sg_len);
+		if (!mq->mqrq[i].sg) {
+			ret = -ENOMEM;
+			goto cleanup_queue;
+		}
+
+		if (!mq->mqrq[i].bounce_buf)
+			continue;
+
+		mq->mqrq[i].bounce_sg = mmc_alloc_sg(sg_len);
+		if (!mq->mqrq[i].bounce_sg) {
+			ret = -ENOMEM;
+			goto cleanup_queue;
+		}
+	}
+	mq->bouncesz = bouncesz;
+
+	for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+		INIT_LIST_HEAD(&mq->mqrq[i].packed_list);
 
-		mq->sg = kmalloc(sizeof(struct scatterlist) *
-			host->max_phys_segs, GFP_KERNEL);
-		if (!mq->sg) {
+		if (!card->ext_csd.packed_event_en)
+			continue;
+
+		mq->mqrq[i].packed_cmd_hdr = kzalloc(MMC_PACKED_HDR_SZ,
+						     GFP_KERNEL);
+		if (!mq->mqrq[i].packed_cmd_hdr) {
 			ret = -ENOMEM;
 			goto cleanup_queue;
 		}
-		sg_init_table(mq->sg, host->max_phys_segs);
 	}
 
 	init_MUTEX(&mq->thread_sem);
@@ -217,21 +317,12 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 	mq->thread = kthread_run(mmc_queue_thread, mq, "mmcqd");
 	if (IS_ERR(mq->thread)) {
 		ret = PTR_ERR(mq->thread);
-		goto free_bounce_sg;
+		goto cleanup_queue;
 	}
 
 	return 0;
- free_bounce_sg:
- 	if (mq->bounce_sg)
- 		kfree(mq->bounce_sg);
- 	mq->bounce_sg = NULL;
  cleanup_queue:
- 	if (mq->sg)
-		kfree(mq->sg);
-	mq->sg = NULL;
-	if (mq->bounce_buf)
-		kfree(mq->bounce_buf);
-	mq->bounce_buf = NULL;
+	mmc_queue_free_bufs(mq);
 	blk_cleanup_queue(mq->queue);
 	return ret;
 }
@@ -253,16 +344,7 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	blk_start_queue(q);
 	spin_unlock_irqrestore(q->queue_lock, flags);
 
- 	if (mq->bounce_sg)
- 		kfree(mq->bounce_sg);
- 	mq->bounce_sg = NULL;
-
-	kfree(mq->sg);
-	mq->sg = NULL;
-
-	if (mq->bounce_buf)
-		kfree(mq->bounce_buf);
-	mq->bounce_buf = NULL;
+	mmc_queue_free_bufs(mq);
 
 	mq->card = NULL;
 }
@@ -312,30 +394,95 @@ void mmc_queue_resume(struct mmc_queue *mq)
 	}
 }
 
+/*
+ * Check whether the host can DMA straight to and from the segments of
+ * a request.  The SDHCI ADMA engine wants 32-bit aligned addresses and
+ * lengths, and a host without scatter/gather only takes one segment.
+ */
+static bool mmc_queue_sg_direct(struct mmc_host *host,
+				struct scatterlist *sglist, unsigned int sg_len)
+{
+	struct scatterlist *sg;
+	int i;
+
+	if (sg_len > host->max_hw_segs)
+		return false;
+
+	for_each_sg(sglist, sg, sg_len, i) {
+		if ((sg->offset & 3) || (sg->length & 3))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * A packed write goes out as its header block followed by the data of
+ * every request in it.
+ */
+static unsigned int mmc_queue_packed_map_sg(struct mmc_queue *mq,
+					    struct mmc_queue_req *mqrq)
+{
+	struct request *req;
+	unsigned int sg_len = 1;
+
+	sg_set_buf(mqrq->sg, mqrq->packed_cmd_hdr, MMC_PACKED_HDR_SZ);
+
+	list_for_each_entry(req, &mqrq->packed_list, queuelist) {
+		/* Each mapping ends the list; carry on past that mark. */
+		mqrq->sg[sg_len - 1].page_link &= ~0x02;
+		sg_len += blk_rq_map_sg(mq->queue, req, mqrq->sg + sg_len);
+	}
+
+	return sg_len;
+}
+
 /*
  * Prepare the sg list(s) to be handed of to the host driver
  */
-unsigned int mmc_queue_map_sg(struct mmc_queue *mq)
+unsigned int mmc_queue_map_sg(struct mmc_queue *mq, struct mmc_queue_req *mqrq)
 {
 	unsigned int sg_len;
 	size_t buflen;
 	struct scatterlist *sg;
 	int i;
 
-	if (!mq->bounce_buf)
-		return blk_rq_map_sg(mq->queue, mq->req, mq->sg);
+	if (mqrq->packed_num)
+		sg_len = mmc_queue_packed_map_sg(mq, mqrq);
+	else
+		sg_len = blk_rq_map_sg(mq->queue, mqrq->req, mqrq->sg);
 
-	BUG_ON(!mq->bounce_sg);
+	buflen = 0;
+	for_each_sg(mqrq->sg, sg, sg_len, i)
+		buflen += sg->length;
 
-	sg_len = blk_rq_map_sg(mq->queue, mq->req, mq->bounce_sg);
+	if (!mqrq->bounce_buf ||
+	    mmc_queue_sg_direct(mq->card->host, mqrq->sg, sg_len)) {
+		mqrq->bounce_sg_len = 0;
+		mq->stats.direct_reqs++;
+		mq->stats.direct_bytes += buflen;
+		return sg_len;
+	}
 
-	mq->bounce_sg_len = sg_len;
+	BUG_ON(!mqrq->bounce_sg);
 
-	buflen = 0;
-	for_each_sg(mq->bounce_sg, sg, sg_len, i)
-		buflen += sg->length;
+	sg_init_table(mqrq->bounce_sg, sg_len);
+	for_each_sg(mqrq->sg, sg, sg_len, i)
+		sg_set_page(&mqrq->bounce_sg[i], sg_page(sg), sg->length,
+			    sg->offset);
+	mqrq->bounce_sg_len = sg_len;
 
-	sg_init_one(mq->sg, mq->bounce_buf, buflen);
+	/*
+	 * Whatever doesn't fit in the bounce buffer is sent as a
+	 * separate transfer once this one has completed.
+	 */
+	if (buflen > mq->bouncesz)
+		buflen = mq->bouncesz;
+
+	sg_init_one(mqrq->sg, mqrq->bounce_buf, buflen);
+
+	mq->stats.bounce_reqs++;
+	mq->stats.bounce_bytes += buflen;
 
 	return 1;
 }
@@ -344,19 +491,19 @@ unsigned int mmc_queue_map_sg(struct mmc_queue *mq)
  * If writing, bounce the data to the buffer before the request
  * is sent to the host driver
  */
-void mmc_queue_bounce_pre(struct mmc_queue *mq)
+void mmc_queue_bounce_pre(struct mmc_queue_req *mqrq)
 {
 	unsigned long flags;
 
-	if (!mq->bounce_buf)
+	if (!mqrq->bounce_sg_len)
 		return;
 
-	if (rq_data_dir(mq->req) != WRITE)
+	if (rq_data_dir(mqrq->req) != WRITE)
 		return;
 
 	local_irq_save(flags);
-	sg_copy_to_buffer(mq->bounce_sg, mq->bounce_sg_len,
-		mq->bounce_buf, mq->sg[0].length);
+	sg_copy_to_buffer(mqrq->bounce_sg, mqrq->bounce_sg_len,
+		mqrq->bounce_buf, mqrq->sg[0].length);
 	local_irq_restore(flags);
 }
 
@@ -364,19 +511,18 @@ void mmc_queue_bounce_pre(struct mmc_queue *mq)
  * If reading, bounce the data from the buffer after the request
  * has been handled by the host driver
  */
-void mmc_queue_bounce_post(struct mmc_queue *mq)
+void mmc_queue_bounce_post(struct mmc_queue_req *mqrq)
 {
 	unsigned long flags;
 
-	if (!mq->bounce_buf)
+	if (!mqrq->bounce_sg_len)
 		return;
 
-	if (rq_data_dir(mq->req) != READ)
+	if (rq_data_dir(mqrq->req) != READ)
 		return;
 
 	local_irq_save(flags);
-	sg_copy_from_buffer(mq->bounce_sg, mq->bounce_sg_len,
-		mq->bounce_buf, mq->sg[0].length);
+	sg_copy_from_buffer(mqrq->bounce_sg, mqrq->bounce_sg_len,
+		mqrq->bounce_buf, mqrq->sg[0].length);
 	local_irq_restore(flags);
 }
-
@@ -4,19 +4,63 @@
 struct request;
 struct task_struct;
 
+struct mmc_blk_request {
+	struct mmc_request	mrq;
+	struct mmc_command	sbc;
+	struct mmc_command	cmd;
+	struct mmc_command	stop;
+	struct mmc_data		data;
+};
+
+/* One packed command header block, and the entries that fit in it */
+#define MMC_PACKED_HDR_SZ	512
+#define MMC_PACKED_MAX		(MMC_PACKED_HDR_SZ / 8 - 1)
+
+struct mmc_queue_req {
+	struct request		*req;
+	struct mmc_blk_request	brq;
+	struct scatterlist	*sg;
+	char			*bounce_buf;
+	struct scatterlist	*bounce_sg;
+	unsigned int		bounce_sg_len;
+	struct mmc_async_req	mmc_active;
+
+	/*
+	 * Write requests gathered into one eMMC packed command, linked
+	 * through their queuelist.  @req is the first of them.
+	 */
+	struct list_head	packed_list;
+	unsigned int		packed_num;
+	unsigned int		packed_blocks;
+	unsigned int		packed_fail_idx;
+	__le32			*packed_cmd_hdr;
+};
+
+/*
+ * Requests (and bytes) sent to the host straight from the request's
+ * pages, versus those copied through a bounce buffer.
+ */
+struct mmc_queue_stats {
+	unsigned long		direct_reqs;
+	unsigned long		bounce_reqs;
+	u64			direct_bytes;
+	u64			bounce_bytes;
+};
+
 struct mmc_queue {
 	struct mmc_card		*card;
 	struct task_struct	*thread;
 	struct semaphore	thread_sem;
 	unsigned int		flags;
-	struct request		*req;
 	int			(*issue_fn)(struct mmc_queue *, struct request *);
+	long			(*idle_fn)(struct mmc_queue *);
 	void			*data;
 	struct request_queue	*queue;
-	struct scatterlist	*sg;
-	char			*bounce_buf;
-	struct scatterlist	*bounce_sg;
-	unsigned int		bounce_sg_len;
+	struct mmc_queue_req	mqrq[2];
+	struct mmc_queue_req	*mqrq_cur;
+	struct mmc_queue_req	*mqrq_prev;
+	unsigned int		bouncesz;
+	struct mmc_queue_stats	stats;
 };
 
 extern int mmc_init_queue(struct mmc_queue *, struct mmc_card *, spinlock_t *);
@@ -24,8 +68,9 @@ extern void mmc_cleanup_queue(struct mmc_queue *);
 extern void mmc_queue_suspend(struct mmc_queue *);
 extern void mmc_queue_resume(struct mmc_queue *);
 
-extern unsigned int mmc_queue_map_sg(struct mmc_queue *);
-extern void mmc_queue_bounce_pre(struct mmc_queue *);
-extern void mmc_queue_bounce_post(struct mmc_queue *);
+extern unsigned int mmc_queue_map_sg(struct mmc_queue *,
+				     struct mmc_queue_req *);
+extern void mmc_queue_bounce_pre(struct mmc_queue_req *);
+extern void mmc_queue_bounce_post(struct mmc_queue_req *);
 
 #endif
@@ -232,7 +232,7 @@ static int mmc_read_ext_csd(struct mmc_card *card)
 	}
 
 	card->ext_csd.rev = ext_csd[EXT_CSD_REV];
-	if (card->ext_csd.rev > 5) {
+	if (card->ext_csd.rev > 6) {
 		printk(KERN_ERR "%s: unrecognised EXT_CSD revision %d\n",
 			mmc_hostname(card->host), card->ext_csd.rev);
 		err = -EINVAL;
@@ -290,6 +290,16 @@ static int mmc_read_ext_csd(struct mmc_card *card)
 			                                           ext_csd[i];
 
 		card->ext_csd.rel_wr_sec_c = ext_csd[EXT_CSD_REL_WR_SEC_C];
+		card->ext_csd.rel_param = ext_csd[EXT_CSD_WR_REL_PARAM];
+		card->ext_csd.sec_feature_support =
+			ext_csd[EXT_CSD_SEC_FEATURE_SUPPORT];
+	}
+
+	if (card->ext_csd.rev >= 6) {
+		card->ext_csd.max_packed_writes =
+			ext_csd[EXT_CSD_MAX_PACKED_WRITES];
+		card->ext_csd.max_packed_reads =
+			ext_csd[EXT_CSD_MAX_PACKED_READS];
 	}
 out:
 	kfree(ext_csd);
@@ -532,6 +542,30 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 		}
 	}
 
+	/*
+	 * Have the card report packed command failures through the
+	 * exception event bit, so the block driver can tell which part
+	 * of a packed write made it.  The spec requires at least three
+	 * packed writes to be supported.
+	 */
+	card->ext_csd.packed_event_en = 0;
+	if (card->ext_csd.max_packed_writes >= 3 &&
+	    mmc_host_packed_wr(host)) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_EXP_EVENTS_CTRL,
+				 EXT_CSD_PACKED_EVENT_EN);
+
+		if (err && err != -EBADMSG)
+			goto free_card;
+
+		if (err) {
+			printk(KERN_WARNING "%s: enabling packed events "
+			       "failed\n", mmc_hostname(card->host));
+			err = 0;
+		} else {
+			card->ext_csd.packed_event_en = 1;
+		}
+	}
 
 	return 0;
 
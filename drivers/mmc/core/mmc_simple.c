@@ -630,7 +630,7 @@ static int mmc_simple_read_ext_csd(struct mmc_card *card)
 	}
 
 	card->ext_csd.rev = mmc_simple_ext_csd[EXT_CSD_REV];
-	if (card->ext_csd.rev > 5) {
+	if (card->ext_csd.rev > 6) {
 		pr_err("%s: unrecognised EXT_CSD structure "
 		       "version %d\n", __func__, card->ext_csd.rev);
 		err = -EINVAL;
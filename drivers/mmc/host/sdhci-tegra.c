@@ -340,6 +340,13 @@ skip_gpio_wp:
 #ifdef CONFIG_ARCH_TEGRA_2x_SOC
 	sdhost->quirks |= SDHCI_QUIRK_BROKEN_SPEC_VERSION |
 		SDHCI_QUIRK_NO_64KB_ADMA;
+	/*
+	 * The ADMA2 engine works even though the capabilities register
+	 * doesn't say so.  Using it lifts the host to 128 segments per
+	 * request instead of one, so the block layer no longer has to
+	 * bounce every request through a single buffer.
+	 */
+	sdhost->quirks2 |= SDHCI_QUIRK2_FORCE_ADMA;
 	sdhost->version = SDHCI_SPEC_200;
 #endif
 
@@ -39,6 +39,17 @@
 #define SDHCI_USE_LEDS_CLASS
 #endif
 
+/*
+ * ADMA2 descriptors are 8 bytes.  A segment takes at most three of
+ * them: the unaligned head, the first half of a 64 KiB segment split
+ * for SDHCI_QUIRK_NO_64KB_ADMA, and the rest of the data.  The table
+ * also needs room for its terminating entry.
+ */
+#define SDHCI_MAX_SEGS		128
+#define SDHCI_ADMA_DESC_SZ	8
+#define SDHCI_ADMA_SIZE		((SDHCI_MAX_SEGS * 3 + 1) * SDHCI_ADMA_DESC_SZ)
+#define SDHCI_ALIGN_SIZE	(SDHCI_MAX_SEGS * 4)
+
 static unsigned int debug_quirks = 0;
 
 static void sdhci_prepare_data(struct sdhci_host *, struct mmc_data *);
@@ -414,13 +425,20 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 	 */
 
 	host->align_addr = dma_map_single(mmc_dev(host->mmc),
-		host->align_buffer, 128 * 4, direction);
+		host->align_buffer, SDHCI_ALIGN_SIZE, direction);
 	if (dma_mapping_error(mmc_dev(host->mmc), host->align_addr))
 		goto fail;
 	BUG_ON(host->align_addr & 0x3);
 
-	host->sg_count = dma_map_sg(mmc_dev(host->mmc),
-		data->sg, data->sg_len, direction);
+	/*
+	 * The data may already have been mapped by sdhci_pre_req()
+	 * while the previous request was being transferred.
+	 */
+	if (data->host_cookie)
+		host->sg_count = data->host_cookie;
+	else
+		host->sg_count = dma_map_sg(mmc_dev(host->mmc),
+			data->sg, data->sg_len, direction);
 	if (host->sg_count == 0)
 		goto unmap_align;
 
@@ -509,7 +527,8 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 		 * If this triggers then we have a calculation bug
 		 * somewhere. :/
 		 */
-		WARN_ON((desc - host->adma_desc) > (128 * 2 + 1) * 4);
+		WARN_ON((desc - host->adma_desc) >
+			SDHCI_ADMA_SIZE - SDHCI_ADMA_DESC_SZ);
 	}
 
 	/*
@@ -531,11 +550,11 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 	 */
 	if (data->flags & MMC_DATA_WRITE) {
 		dma_sync_single_for_device(mmc_dev(host->mmc),
-			host->align_addr, 128 * 4, direction);
+			host->align_addr, SDHCI_ALIGN_SIZE, direction);
 	}
 
 	host->adma_addr = dma_map_single(mmc_dev(host->mmc),
-		host->adma_desc, (128 * 2 + 1) * 4, DMA_TO_DEVICE);
+		host->adma_desc, SDHCI_ADMA_SIZE, DMA_TO_DEVICE);
 	if (dma_mapping_error(mmc_dev(host->mmc), host->adma_addr))
 		goto unmap_entries;
 	BUG_ON(host->adma_addr & 0x3);
@@ -543,11 +562,12 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 	return 0;
 
 unmap_entries:
-	dma_unmap_sg(mmc_dev(host->mmc), data->sg,
-		data->sg_len, direction);
+	if (!data->host_cookie)
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg,
+			data->sg_len, direction);
 unmap_align:
 	dma_unmap_single(mmc_dev(host->mmc), host->align_addr,
-		128 * 4, direction);
+		SDHCI_ALIGN_SIZE, direction);
 fail:
 	return -EINVAL;
 }
@@ -569,10 +589,10 @@ static void sdhci_adma_table_post(struct sdhci_host *host,
 		direction = DMA_TO_DEVICE;
 
 	dma_unmap_single(mmc_dev(host->mmc), host->adma_addr,
-		(128 * 2 + 1) * 4, DMA_TO_DEVICE);
+		SDHCI_ADMA_SIZE, DMA_TO_DEVICE);
 
 	dma_unmap_single(mmc_dev(host->mmc), host->align_addr,
-		128 * 4, direction);
+		SDHCI_ALIGN_SIZE, direction);
 
 	if (data->flags & MMC_DATA_READ) {
 		dma_sync_sg_for_cpu(mmc_dev(host->mmc), data->sg,
@@ -594,8 +614,10 @@ static void sdhci_adma_table_post(struct sdhci_host *host,
 		}
 	}
 
-	dma_unmap_sg(mmc_dev(host->mmc), data->sg,
-		data->sg_len, direction);
+	/* Pre-mapped data is unmapped by sdhci_post_req() */
+	if (!data->host_cookie)
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg,
+			data->sg_len, direction);
 }
 
 static u8 sdhci_calc_timeout(struct sdhci_host *host, struct mmc_data *data)
@@ -764,7 +786,10 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_data *data)
 		} else {
 			int sg_cnt;
 
-			sg_cnt = dma_map_sg(mmc_dev(host->mmc),
+			if (data->host_cookie)
+				sg_cnt = data->host_cookie;
+			else
+				sg_cnt = dma_map_sg(mmc_dev(host->mmc),
 					data->sg, data->sg_len,
 					(data->flags & MMC_DATA_READ) ?
 						DMA_FROM_DEVICE :
@@ -784,6 +809,17 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_data *data)
 		}
 	}
 
+	/*
+	 * Data mapped ahead of time by sdhci_pre_req() has to be handed
+	 * back to the CPU if we ended up falling back to PIO.
+	 */
+	if (!(host->flags & SDHCI_REQ_USE_DMA) && data->host_cookie) {
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+			(data->flags & MMC_DATA_READ) ?
+				DMA_FROM_DEVICE : DMA_TO_DEVICE);
+		data->host_cookie = 0;
+	}
+
 	/*
 	 * Always adjust the DMA selection as some controllers
 	 * (e.g. JMicron) can't do PIO properly when the selection
@@ -852,7 +888,7 @@ static void sdhci_finish_data(struct sdhci_host *host)
 	if (host->flags & SDHCI_REQ_USE_DMA) {
 		if (host->flags & SDHCI_USE_ADMA)
 			sdhci_adma_table_post(host, data);
-		else {
+		else if (!data->host_cookie) {
 			dma_unmap_sg(mmc_dev(host->mmc), data->sg,
 				data->sg_len, (data->flags & MMC_DATA_READ) ?
 					DMA_FROM_DEVICE : DMA_TO_DEVICE);
@@ -871,7 +907,11 @@ static void sdhci_finish_data(struct sdhci_host *host)
 	else
 		data->bytes_xfered = data->blksz * data->blocks;
 
-	if (data->stop) {
+	/*
+	 * A transfer set up with SET_BLOCK_COUNT ends by itself; the stop
+	 * command is only needed to get the card out of an aborted one.
+	 */
+	if (data->stop && (data->error || !host->mrq->sbc)) {
 		/*
 		 * The controller needs a reset of internal state machines
 		 * upon error conditions.
@@ -993,6 +1033,13 @@ static void sdhci_finish_command(struct sdhci_host *host)
 
 	host->cmd->error = 0;
 
+	/* Finished CMD23, now send the actual command. */
+	if (host->cmd == host->mrq->sbc) {
+		host->cmd = NULL;
+		sdhci_send_command(host, host->mrq->cmd);
+		return;
+	}
+
 	if (host->data && host->data_early)
 		sdhci_finish_data(host);
 
@@ -1195,13 +1242,53 @@ static void sdhci_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	if (!present || host->flags & SDHCI_DEVICE_DEAD) {
 		host->mrq->cmd->error = -ENOMEDIUM;
 		tasklet_schedule(&host->finish_tasklet);
-	} else
+	} else if (mrq->sbc)
+		sdhci_send_command(host, mrq->sbc);
+	else
 		sdhci_send_command(host, mrq->cmd);
 
 	mmiowb();
 	spin_unlock_irqrestore(&host->lock, flags);
 }
 
+/*
+ * Map the data of a request for DMA while the previous request is still
+ * being transferred, so that the cache maintenance is off the critical
+ * path.  The number of mapped entries is kept in data->host_cookie.
+ */
+static void sdhci_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
+	bool is_first_req)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+
+	if (!data || data->host_cookie)
+		return;
+
+	if (!(host->flags & (SDHCI_USE_SDMA | SDHCI_USE_ADMA)))
+		return;
+
+	data->host_cookie = dma_map_sg(mmc_dev(host->mmc),
+		data->sg, data->sg_len,
+		(data->flags & MMC_DATA_READ) ?
+			DMA_FROM_DEVICE : DMA_TO_DEVICE);
+}
+
+static void sdhci_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+	int err)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+
+	if (!data || !data->host_cookie)
+		return;
+
+	dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+		(data->flags & MMC_DATA_READ) ?
+			DMA_FROM_DEVICE : DMA_TO_DEVICE);
+	data->host_cookie = 0;
+}
+
 static void sdhci_set_ios(struct mmc_host *mmc, struct mmc_ios *ios)
 {
 	struct sdhci_host *host;
@@ -1362,6 +1449,8 @@ static unsigned int sdhci_get_host_offset(struct mmc_host *mmc) {
 #endif
 
 static const struct mmc_host_ops sdhci_ops = {
+	.pre_req	= sdhci_pre_req,
+	.post_req	= sdhci_post_req,
 	.request	= sdhci_request,
 	.set_ios	= sdhci_set_ios,
 	.get_ro		= sdhci_get_ro,
@@ -1436,6 +1525,7 @@ static void sdhci_tasklet_finish(unsigned long param)
 	 */
 	if (!(host->flags & SDHCI_DEVICE_DEAD) &&
 		(mrq->cmd->error ||
+		 (mrq->sbc && mrq->sbc->error) ||
 		 (mrq->data && (mrq->data->error ||
 		  (mrq->data->stop && mrq->data->stop->error))) ||
 		   (host->quirks & SDHCI_QUIRK_RESET_AFTER_REQUEST))) {
@@ -1856,7 +1946,9 @@ int sdhci_add_host(struct sdhci_host *host)
 		host->flags &= ~SDHCI_USE_SDMA;
 	}
 
-	if ((host->version >= SDHCI_SPEC_200) && (caps & SDHCI_CAN_DO_ADMA2))
+	if ((host->version >= SDHCI_SPEC_200) &&
+	    ((caps & SDHCI_CAN_DO_ADMA2) ||
+	     (host->quirks2 & SDHCI_QUIRK2_FORCE_ADMA)))
 		host->flags |= SDHCI_USE_ADMA;
 
 	if ((host->quirks & SDHCI_QUIRK_BROKEN_ADMA) &&
@@ -1879,12 +1971,12 @@ int sdhci_add_host(struct sdhci_host *host)
 
 	if (host->flags & SDHCI_USE_ADMA) {
 		/*
-		 * We need to allocate descriptors for all sg entries
-		 * (128) and potentially one alignment transfer for
-		 * each of those entries.
+		 * We need to allocate descriptors for all sg entries,
+		 * with room for an alignment transfer and a 64 KiB
+		 * split for each of those entries.
 		 */
-		host->adma_desc = kmalloc((128 * 2 + 1) * 4, GFP_KERNEL);
-		host->align_buffer = kmalloc(128 * 4, GFP_KERNEL);
+		host->adma_desc = kmalloc(SDHCI_ADMA_SIZE, GFP_KERNEL);
+		host->align_buffer = kmalloc(SDHCI_ALIGN_SIZE, GFP_KERNEL);
 		if (!host->adma_desc || !host->align_buffer) {
 			kfree(host->adma_desc);
 			kfree(host->align_buffer);
@@ -1969,6 +2061,16 @@ int sdhci_add_host(struct sdhci_host *host)
 	if (host->data_width >= 8)
 		mmc->caps |= MMC_CAP_8_BIT_DATA;
 
+	/*
+	 * A packed write carries its header in a separate segment, so
+	 * only offer it when the controller can scatter/gather.
+	 */
+	if (!(host->quirks2 & SDHCI_QUIRK2_NO_CMD23)) {
+		mmc->caps |= MMC_CAP_CMD23;
+		if (host->flags & SDHCI_USE_ADMA)
+			mmc->caps |= MMC_CAP_PACKED_WR;
+	}
+
 #ifdef CONFIG_MACH_MOT
 	if (!mmc->ocr_avail) {
 		if (caps & SDHCI_CAN_VDD_330)
@@ -2001,7 +2103,7 @@ int sdhci_add_host(struct sdhci_host *host)
 	 * can do scatter/gather or not.
 	 */
 	if (host->flags & SDHCI_USE_ADMA)
-		mmc->max_hw_segs = 128;
+		mmc->max_hw_segs = SDHCI_MAX_SEGS;
 	else if (host->flags & SDHCI_USE_SDMA)
 		mmc->max_hw_segs = 1;
 	else /* PIO */
@@ -250,6 +250,13 @@ struct sdhci_host {
 /* Controller allows runtime enable / disable */
 #define SDHCI_QUIRK_RUNTIME_DISABLE			(1<<31)
 
+	unsigned int		quirks2;	/* More deviations from spec. */
+
+/* Controller has bad caps bits, but really supports ADMA2 */
+#define SDHCI_QUIRK2_FORCE_ADMA				(1<<0)
+/* Controller can't send SET_BLOCK_COUNT ahead of a data command */
+#define SDHCI_QUIRK2_NO_CMD23				(1<<1)
+
 	int			irq;		/* Device IRQ */
 	void __iomem *		ioaddr;		/* Mapped address */
 
@@ -128,6 +128,7 @@ static enum hrtimer_restart gpio_event_input_timer_func(struct hrtimer *timer)
 				key_entry->code, i, key_entry->gpio, pressed);
 		input_event(ds->input_dev, ds->info->type,
 			    key_entry->code, pressed);
+		input_sync(ds->input_dev);
 	}
 
 #if 0
@@ -195,6 +196,7 @@ static irqreturn_t gpio_event_input_irq_handler(int irq, void *dev_id)
 				key_entry->gpio, pressed);
 		input_event(ds->input_dev, ds->info->type,
 			    key_entry->code, pressed);
+		input_sync(ds->input_dev);
 	}
 	return IRQ_HANDLED;
 }
@@ -103,6 +103,17 @@ static inline struct f_rndis *func_to_rndis(struct usb_function *f)
 	return container_of(f, struct f_rndis, port.func);
 }
 
+/* RNDIS lets both sides pack several packet messages into a transfer */
+static unsigned rndis_rx_pkts_per_xfer = 4;
+module_param(rndis_rx_pkts_per_xfer, uint, S_IRUGO);
+MODULE_PARM_DESC(rndis_rx_pkts_per_xfer,
+		"packets per transfer accepted from the host");
+
+static unsigned rndis_tx_pkts_per_xfer = 4;
+module_param(rndis_tx_pkts_per_xfer, uint, S_IRUGO);
+MODULE_PARM_DESC(rndis_tx_pkts_per_xfer,
+		"packets per transfer sent to the host, 1 disables aggregation");
+
 /* peak (theoretical) bulk transfer rate in bits-per-second */
 static unsigned int bitrate(struct usb_gadget *g)
 {
@@ -813,6 +824,8 @@ rndis_bind(struct usb_configuration *c, struct usb_function *f)
 	rndis->config = status;
 
 	rndis_set_param_medium(rndis->config, NDIS_MEDIUM_802_3, 0);
+	rndis_set_param_xfer(rndis->config, rndis->port.rx_max_frames,
+			&rndis->port.tx_max_len);
 	rndis_set_host_mac(rndis->config, rndis->ethaddr);
 
 #ifdef CONFIG_USB_ANDROID_RNDIS
@@ -959,6 +972,8 @@ int __init rndis_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN])
 	rndis->port.header_len = sizeof(struct rndis_packet_msg_type);
 	rndis->port.wrap = rndis_add_header;
 	rndis->port.unwrap = rndis_rm_hdr;
+	rndis->port.rx_max_frames = rndis_rx_pkts_per_xfer;
+	rndis->port.tx_max_frames = rndis_tx_pkts_per_xfer;
 
 	rndis->port.func.name = "rndis";
 	rndis->port.func.strings = rndis_strings;
@@ -56,6 +56,7 @@
 #define MAX_BULK_TX_REQ_NUM	8
 #define MAX_BULK_RX_REQ_NUM	8
 #define MAX_INTR_RX_REQ_NUM	8
+#define USBNET_NAPI_WEIGHT	64
 
 struct usbnet_if_configuration {
 	u32 ip_addr;
@@ -80,6 +81,10 @@ struct usbnet_context {
 	struct list_head rx_reqs;
 	struct list_head tx_reqs;
 
+	/* completed rx buffers, handed to the stack by usbnet_poll() */
+	struct napi_struct napi;
+	struct sk_buff_head rx_done;
+
 	struct net_device_stats stats;
 };
 
@@ -271,7 +276,7 @@ static int ether_queue_out(struct usb_request *req)
 	req->length = USB_MTU;
 	req->context = skb;
 
-	ret = usb_ep_queue(g_usbnet_context->bulk_out, req, GFP_KERNEL);
+	ret = usb_ep_queue(g_usbnet_context->bulk_out, req, GFP_ATOMIC);
 	if (ret == 0)
 		return 0;
 	dev_kfree_skb_any(skb);
@@ -283,6 +288,60 @@ fail:
 	return ret;
 }
 
+static void ether_rx_fill(void)
+{
+	unsigned long flags;
+	struct usb_request *req;
+
+	for (;;) {
+		spin_lock_irqsave(&g_usbnet_context->lock, flags);
+		if (list_empty(&g_usbnet_context->rx_reqs)) {
+			req = 0;
+		} else {
+			req = list_first_entry(&g_usbnet_context->rx_reqs,
+					       struct usb_request, list);
+			list_del(&req->list);
+		}
+		spin_unlock_irqrestore(&g_usbnet_context->lock, flags);
+		if (!req)
+			break;
+		if (ether_queue_out(req)) {
+			printk(KERN_INFO "%s: ether_queue_out failed\n",
+				__func__);
+			break;
+		}
+	}
+}
+
+static int usbnet_poll(struct napi_struct *napi, int budget)
+{
+	struct sk_buff *skb;
+	int work_done = 0;
+
+	while (work_done < budget) {
+		skb = skb_dequeue(&g_usbnet_context->rx_done);
+		if (!skb)
+			break;
+		skb->protocol = eth_type_trans(skb, g_usbnet_context->dev);
+		g_usbnet_context->stats.rx_packets++;
+		g_usbnet_context->stats.rx_bytes += skb->len;
+		napi_gro_receive(napi, skb);
+		work_done++;
+	}
+
+	/* requeue all the requests freed above at once */
+	if (g_usbnet_context->config)
+		ether_rx_fill();
+
+	if (work_done < budget) {
+		napi_complete(napi);
+		if (!skb_queue_empty(&g_usbnet_context->rx_done))
+			napi_reschedule(napi);
+	}
+
+	return work_done;
+}
+
 static int usb_ether_xmit(struct sk_buff *skb, struct net_device *dev)
 {
 	struct usb_request *req;
@@ -337,12 +396,23 @@ static int usb_ether_xmit(struct sk_buff *skb, struct net_device *dev)
 static int usb_ether_open(struct net_device *dev)
 {
 	printk(KERN_INFO "%s\n", __func__);
+	napi_enable(&g_usbnet_context->napi);
+
+	/* rx completions parked their requests while NAPI was off,
+	 * requeue them and pick up anything that completed meanwhile
+	 */
+	if (g_usbnet_context->config) {
+		ether_rx_fill();
+		napi_schedule(&g_usbnet_context->napi);
+	}
 	return 0;
 }
 
 static int usb_ether_stop(struct net_device *dev)
 {
 	printk(KERN_INFO "%s\n", __func__);
+	napi_disable(&g_usbnet_context->napi);
+	skb_queue_purge(&g_usbnet_context->rx_done);
 	return 0;
 }
 
@@ -410,6 +480,7 @@ static void usb_ether_setup(struct net_device *dev)
 	INIT_LIST_HEAD(&g_usbnet_context->tx_reqs);
 
 	spin_lock_init(&g_usbnet_context->lock);
+	skb_queue_head_init(&g_usbnet_context->rx_done);
 	g_usbnet_context->dev = dev;
 
 	dev->netdev_ops = &eth_netdev_ops;
@@ -418,6 +489,10 @@ static void usb_ether_setup(struct net_device *dev)
 
 	ether_setup(dev);
 
+	dev->features |= NETIF_F_GRO;
+	netif_napi_add(dev, &g_usbnet_context->napi, usbnet_poll,
+		       USBNET_NAPI_WEIGHT);
+
 	random_ether_addr(dev->dev_addr);
 }
 
@@ -488,30 +563,27 @@ static void usbnet_unbind(struct usb_configuration *c, struct usb_function *f)
 static void ether_out_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff *skb = req->context;
+	unsigned long flags;
 
 	if (req->status == 0) {
 		dmac_inv_range((void *)req->buf, (void *)(req->buf +
 					req->actual));
 		skb_put(skb, req->actual);
-		skb->protocol = eth_type_trans(skb, g_usbnet_context->dev);
-		g_usbnet_context->stats.rx_packets++;
-		g_usbnet_context->stats.rx_bytes += req->actual;
-		netif_rx(skb);
+		skb_queue_tail(&g_usbnet_context->rx_done, skb);
 	} else {
 		dev_kfree_skb_any(skb);
 		g_usbnet_context->stats.rx_errors++;
 	}
 
-	/* don't bother requeuing if we just went offline */
-	if ((req->status == -ENODEV) || (req->status == -ESHUTDOWN)) {
-		unsigned long flags;
-		spin_lock_irqsave(&g_usbnet_context->lock, flags);
-		list_add_tail(&req->list, &g_usbnet_context->rx_reqs);
-		spin_unlock_irqrestore(&g_usbnet_context->lock, flags);
-	} else {
-		if (ether_queue_out(req))
-			printk(KERN_INFO "ether_out: cannot requeue\n");
-	}
+	spin_lock_irqsave(&g_usbnet_context->lock, flags);
+	list_add_tail(&req->list, &g_usbnet_context->rx_reqs);
+	spin_unlock_irqrestore(&g_usbnet_context->lock, flags);
+
+	/* don't bother requeuing if we just went offline, otherwise
+	 * usbnet_poll() passes the data up and requeues the request
+	 */
+	if ((req->status != -ENODEV) && (req->status != -ESHUTDOWN))
+		napi_schedule(&g_usbnet_context->napi);
 }
 
 static void ether_in_complete(struct usb_ep *ep, struct usb_request *req)
@@ -639,8 +711,6 @@ autoconf_fail:
 static void do_set_config(u16 new_config)
 {
 	int result = 0;
-	unsigned long flags;
-	struct usb_request *req;
 	int high_speed_flag = 0;
 
 	if (g_usbnet_context->config == new_config) /* Config did not change */
@@ -693,25 +763,7 @@ static void do_set_config(u16 new_config)
 
 
 		/* we're online -- get all rx requests queued */
-		for (;;) {
-			spin_lock_irqsave(&g_usbnet_context->lock, flags);
-			if (list_empty(&g_usbnet_context->rx_reqs)) {
-				req = 0;
-			} else {
-				req = list_first_entry(
-						&g_usbnet_context->rx_reqs,
-						struct usb_request, list);
-				list_del(&req->list);
-			}
-			spin_unlock_irqrestore(&g_usbnet_context->lock, flags);
-			if (!req)
-				break;
-			if (ether_queue_out(req)) {
-				printk(KERN_INFO "%s: ether_queue_out failed\n",
-					__func__);
-				break;
-			}
-		}
+		ether_rx_fill();
 		netif_start_queue(g_net_dev);
 
 	} else {
@@ -580,16 +580,20 @@ static int rndis_init_response (int configNr, rndis_init_msg_type *buf)
 	resp->MinorVersion = cpu_to_le32 (RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = cpu_to_le32 (RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = cpu_to_le32 (RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = cpu_to_le32 (1);
-	resp->MaxTransferSize = cpu_to_le32 (
+	resp->MaxPacketsPerTransfer = cpu_to_le32 (params->max_pkt_per_xfer);
+	resp->MaxTransferSize = cpu_to_le32 (params->max_pkt_per_xfer * (
 		  params->dev->mtu
 		+ sizeof (struct ethhdr)
 		+ sizeof (struct rndis_packet_msg_type)
-		+ 22);
+		+ 22));
 	resp->PacketAlignmentFactor = cpu_to_le32 (0);
 	resp->AFListOffset = cpu_to_le32 (0);
 	resp->AFListSize = cpu_to_le32 (0);
 
+	/* how much the host takes in one transfer, for TX aggregation */
+	if (params->host_max_xfer)
+		*params->host_max_xfer = le32_to_cpu(buf->MaxTransferSize);
+
 	params->resp_avail(params->v);
 	return 0;
 }
@@ -899,6 +903,8 @@ int rndis_register(void (*resp_avail)(void *v), void *v)
 			rndis_per_dev_params [i].used = 1;
 			rndis_per_dev_params [i].resp_avail = resp_avail;
 			rndis_per_dev_params [i].v = v;
+			rndis_per_dev_params [i].max_pkt_per_xfer = 1;
+			rndis_per_dev_params [i].host_max_xfer = NULL;
 			pr_debug("%s: configNr = %d\n", __func__, i);
 			return i;
 		}
@@ -954,6 +960,19 @@ int rndis_set_param_medium (u8 configNr, u32 medium, u32 speed)
 	return 0;
 }
 
+int rndis_set_param_xfer(u8 configNr, u32 max_pkt_per_xfer,
+			 u32 *host_max_xfer)
+{
+	pr_debug("%s: %u\n", __func__, max_pkt_per_xfer);
+	if (configNr >= RNDIS_MAX_CONFIGS) return -1;
+
+	rndis_per_dev_params [configNr].max_pkt_per_xfer =
+		max(max_pkt_per_xfer, 1U);
+	rndis_per_dev_params [configNr].host_max_xfer = host_max_xfer;
+
+	return 0;
+}
+
 void rndis_add_hdr (struct sk_buff *skb)
 {
 	struct rndis_packet_msg_type	*header;
@@ -1022,30 +1041,68 @@ static rndis_resp_t *rndis_add_response (int configNr, u32 length)
 	return r;
 }
 
+/*
+ * One transfer may carry up to max_pkt_per_xfer packet messages back
+ * to back.  All but the last are cloned off the transfer's skb; the
+ * last one (usually the only one) reuses it.  Trailing bytes too short
+ * to be a message are the host's padding.
+ */
 int rndis_rm_hdr(struct gether *port,
 			struct sk_buff *skb,
 			struct sk_buff_head *list)
 {
-	/* tmp points to a struct rndis_packet_msg_type */
-	__le32		*tmp = (void *) skb->data;
+	struct sk_buff	*skb2;
+	bool		first = true;
+
+	while (skb->len >= sizeof(struct rndis_packet_msg_type)) {
+		/* tmp points to a struct rndis_packet_msg_type */
+		__le32		*tmp = (void *) skb->data;
+		u32		msg_len, data_offset, data_len;
+
+		/* MessageType, MessageLength */
+		if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
+				!= get_unaligned(tmp++)) {
+			if (!first)
+				break;
+			dev_kfree_skb_any(skb);
+			return -EINVAL;
+		}
+		msg_len = get_unaligned_le32(tmp++);
+		if (msg_len < sizeof(struct rndis_packet_msg_type)
+				|| msg_len > skb->len)
+			msg_len = skb->len;
+
+		/* DataOffset, DataLength */
+		data_offset = get_unaligned_le32(tmp++) + 8;
+		data_len = get_unaligned_le32(tmp++);
+		if (data_offset > msg_len) {
+			dev_kfree_skb_any(skb);
+			return -EOVERFLOW;
+		}
+		data_len = min(data_len, msg_len - data_offset);
 
-	/* MessageType, MessageLength */
-	if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
-			!= get_unaligned(tmp++)) {
-		dev_kfree_skb_any(skb);
-		return -EINVAL;
-	}
-	tmp++;
+		if (msg_len == skb->len) {
+			skb_pull(skb, data_offset);
+			skb_trim(skb, data_len);
+			skb_queue_tail(list, skb);
+			return 0;
+		}
+
+		skb2 = skb_clone(skb, GFP_ATOMIC);
+		if (!skb2) {
+			dev_kfree_skb_any(skb);
+			return -ENOMEM;
+		}
+		skb_pull(skb2, data_offset);
+		skb_trim(skb2, data_len);
+		skb_queue_tail(list, skb2);
 
-	/* DataOffset, DataLength */
-	if (!skb_pull(skb, get_unaligned_le32(tmp++) + 8)) {
-		dev_kfree_skb_any(skb);
-		return -EOVERFLOW;
+		skb_pull(skb, msg_len);
+		first = false;
 	}
-	skb_trim(skb, get_unaligned_le32(tmp++));
 
-	skb_queue_tail(list, skb);
-	return 0;
+	dev_kfree_skb_any(skb);
+	return first ? -EINVAL : 0;
 }
 
 #ifdef	CONFIG_USB_GADGET_DEBUG_FILES
@@ -70,6 +70,10 @@ struct eth_dev {
 
 	struct sk_buff_head	rx_frames;
 
+	/* completed rx buffers, handed to the stack by eth_poll() */
+	struct napi_struct	napi;
+	struct sk_buff_head	rx_done;
+
 	unsigned		header_len;
 	struct sk_buff		*(*wrap)(struct gether *, struct sk_buff *skb);
 	int			(*unwrap)(struct gether *,
@@ -81,6 +85,18 @@ struct eth_dev {
 	unsigned long		todo;
 #define	WORK_RX_MEMORY		0
 
+	/* multi-frame transfers: tx_agg_req is being filled by
+	 * eth_xmit_agg(), under req_lock
+	 */
+	unsigned		rx_max_frames;
+	unsigned		tx_max_frames;
+	unsigned		tx_buf_len;
+	struct usb_request	*tx_agg_req;
+
+	/* frames per transfer, for ethtool -S */
+	unsigned long		tx_xfers, tx_xfer_frames, tx_xfer_max;
+	unsigned long		rx_xfers, rx_xfer_frames, rx_xfer_max;
+
 	bool			zlp;
 	u8			host_mac[ETH_ALEN];
 };
@@ -91,6 +107,8 @@ struct eth_dev {
 
 #define DEFAULT_QLEN	2	/* double buffering by default */
 
+#define ETH_NAPI_WEIGHT	64	/* frames per eth_poll() */
+
 
 #ifdef CONFIG_USB_GADGET_DUALSPEED
 
@@ -185,9 +203,50 @@ static void eth_get_drvinfo(struct net_device *net, struct ethtool_drvinfo *p)
  *   - ... probably more ethtool ops
  */
 
+static const char eth_stats_strings[][ETH_GSTRING_LEN] = {
+	"tx_xfers",
+	"tx_xfer_frames",
+	"tx_xfer_max_frames",
+	"rx_xfers",
+	"rx_xfer_frames",
+	"rx_xfer_max_frames",
+};
+
+static int eth_get_sset_count(struct net_device *net, int sset)
+{
+	switch (sset) {
+	case ETH_SS_STATS:
+		return ARRAY_SIZE(eth_stats_strings);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static void eth_get_strings(struct net_device *net, u32 sset, u8 *data)
+{
+	if (sset == ETH_SS_STATS)
+		memcpy(data, eth_stats_strings, sizeof eth_stats_strings);
+}
+
+static void eth_get_ethtool_stats(struct net_device *net,
+		struct ethtool_stats *stats, u64 *data)
+{
+	struct eth_dev	*dev = netdev_priv(net);
+
+	data[0] = dev->tx_xfers;
+	data[1] = dev->tx_xfer_frames;
+	data[2] = dev->tx_xfer_max;
+	data[3] = dev->rx_xfers;
+	data[4] = dev->rx_xfer_frames;
+	data[5] = dev->rx_xfer_max;
+}
+
 static const struct ethtool_ops ops = {
 	.get_drvinfo = eth_get_drvinfo,
 	.get_link = ethtool_op_get_link,
+	.get_sset_count = eth_get_sset_count,
+	.get_strings = eth_get_strings,
+	.get_ethtool_stats = eth_get_ethtool_stats,
 };
 
 static void defer_kevent(struct eth_dev *dev, int flag)
@@ -236,6 +295,7 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
 	size += dev->port_usb->header_len;
+	size *= dev->rx_max_frames;
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
@@ -273,7 +333,7 @@ enomem:
 
 static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct sk_buff	*skb = req->context, *skb2;
+	struct sk_buff	*skb = req->context;
 	struct eth_dev	*dev = ep->driver_data;
 	int		status = req->status;
 
@@ -282,47 +342,8 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 	/* normal completion */
 	case 0:
 		skb_put(skb, req->actual);
-
-		if (dev->unwrap) {
-			unsigned long	flags;
-
-			spin_lock_irqsave(&dev->lock, flags);
-			if (dev->port_usb) {
-				status = dev->unwrap(dev->port_usb,
-							skb,
-							&dev->rx_frames);
-			} else {
-				dev_kfree_skb_any(skb);
-				status = -ENOTCONN;
-			}
-			spin_unlock_irqrestore(&dev->lock, flags);
-		} else {
-			skb_queue_tail(&dev->rx_frames, skb);
-		}
+		skb_queue_tail(&dev->rx_done, skb);
 		skb = NULL;
-
-		skb2 = skb_dequeue(&dev->rx_frames);
-		while (skb2) {
-			if (status < 0
-					|| ETH_HLEN > skb2->len
-					|| skb2->len > ETH_FRAME_LEN) {
-				dev->net->stats.rx_errors++;
-				dev->net->stats.rx_length_errors++;
-				DBG(dev, "rx length %d\n", skb2->len);
-				dev_kfree_skb_any(skb2);
-				goto next_frame;
-			}
-			skb2->protocol = eth_type_trans(skb2, dev->net);
-			dev->net->stats.rx_packets++;
-			dev->net->stats.rx_bytes += skb2->len;
-
-			/* no buffer copies needed, unless hardware can't
-			 * use skb buffers.
-			 */
-			status = netif_rx(skb2);
-next_frame:
-			skb2 = skb_dequeue(&dev->rx_frames);
-		}
 		break;
 
 	/* software-driven interface shutdown */
@@ -352,15 +373,18 @@ quiesce:
 
 	if (skb)
 		dev_kfree_skb_any(skb);
-	if (!netif_running(dev->net)) {
+
+	/* eth_poll() passes the data up and requeues the request */
+	spin_lock(&dev->req_lock);
+	list_add(&req->list, &dev->rx_reqs);
+	spin_unlock(&dev->req_lock);
+	napi_schedule(&dev->napi);
+	return;
+
 clean:
-		spin_lock(&dev->req_lock);
-		list_add(&req->list, &dev->rx_reqs);
-		spin_unlock(&dev->req_lock);
-		req = NULL;
-	}
-	if (req)
-		rx_submit(dev, req, GFP_ATOMIC);
+	spin_lock(&dev->req_lock);
+	list_add(&req->list, &dev->rx_reqs);
+	spin_unlock(&dev->req_lock);
 }
 
 static int prealloc(struct list_head *list, struct usb_ep *ep, unsigned n)
@@ -421,6 +445,38 @@ done:
 	return status;
 }
 
+/* aggregated TX copies frames into buffers of its own */
+static void free_tx_buffers(struct eth_dev *dev, struct usb_request *last)
+{
+	struct usb_request	*req;
+
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		if (req == last)
+			break;
+		kfree(req->buf);
+		req->buf = NULL;
+	}
+}
+
+static int alloc_tx_buffers(struct eth_dev *dev, unsigned len)
+{
+	struct usb_request	*req;
+
+	spin_lock(&dev->req_lock);
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		/* one spare byte for the zlp workaround */
+		req->buf = kmalloc(len + 1, GFP_ATOMIC);
+		if (!req->buf) {
+			free_tx_buffers(dev, req);
+			spin_unlock(&dev->req_lock);
+			return -ENOMEM;
+		}
+	}
+	dev->tx_buf_len = len;
+	spin_unlock(&dev->req_lock);
+	return 0;
+}
+
 static void rx_fill(struct eth_dev *dev, gfp_t gfp_flags)
 {
 	struct usb_request	*req;
@@ -457,10 +513,112 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static void rx_unwrap(struct eth_dev *dev, struct sk_buff *skb)
+{
+	struct sk_buff	*skb2;
+	unsigned long	flags;
+	unsigned	frames = skb_queue_len(&dev->rx_frames);
+	int		status = 0;
+
+	if (dev->unwrap) {
+		spin_lock_irqsave(&dev->lock, flags);
+		if (dev->port_usb) {
+			status = dev->unwrap(dev->port_usb,
+						skb,
+						&dev->rx_frames);
+		} else {
+			dev_kfree_skb_any(skb);
+			status = -ENOTCONN;
+		}
+		spin_unlock_irqrestore(&dev->lock, flags);
+	} else {
+		skb_queue_tail(&dev->rx_frames, skb);
+	}
+
+	frames = skb_queue_len(&dev->rx_frames) - frames;
+	dev->rx_xfers++;
+	dev->rx_xfer_frames += frames;
+	if (frames > dev->rx_xfer_max)
+		dev->rx_xfer_max = frames;
+
+	/* drop anything a failed unwrap left behind */
+	if (status < 0) {
+		while ((skb2 = __skb_dequeue(&dev->rx_frames)) != NULL) {
+			dev->net->stats.rx_errors++;
+			dev->net->stats.rx_length_errors++;
+			DBG(dev, "rx unwrap %d\n", status);
+			dev_kfree_skb_any(skb2);
+		}
+	}
+}
+
+/*
+ * NAPI poll: hand up to @budget completed frames to the stack, then
+ * put every request they freed back on the OUT endpoint in one go.
+ * rx_frames may still hold frames unwrapped from one USB transfer
+ * (RNDIS, EEM) when the budget runs out; they go first next time.
+ */
+static int eth_poll(struct napi_struct *napi, int budget)
+{
+	struct eth_dev	*dev = container_of(napi, struct eth_dev, napi);
+	struct sk_buff	*skb;
+	int		work_done = 0;
+
+	while (work_done < budget) {
+		skb = __skb_dequeue(&dev->rx_frames);
+		if (!skb) {
+			skb = skb_dequeue(&dev->rx_done);
+			if (!skb)
+				break;
+			rx_unwrap(dev, skb);
+			continue;
+		}
+
+		if (ETH_HLEN > skb->len || skb->len > ETH_FRAME_LEN) {
+			dev->net->stats.rx_errors++;
+			dev->net->stats.rx_length_errors++;
+			DBG(dev, "rx length %d\n", skb->len);
+			dev_kfree_skb_any(skb);
+			continue;
+		}
+		skb->protocol = eth_type_trans(skb, dev->net);
+		dev->net->stats.rx_packets++;
+		dev->net->stats.rx_bytes += skb->len;
+
+		/* no buffer copies needed, unless hardware can't
+		 * use skb buffers.
+		 */
+		napi_gro_receive(napi, skb);
+		work_done++;
+	}
+
+	rx_fill(dev, GFP_ATOMIC);
+
+	if (work_done < budget) {
+		napi_complete(napi);
+		/* rx_complete() may have queued more after we looked */
+		if (!skb_queue_empty(&dev->rx_done))
+			napi_reschedule(napi);
+	}
+
+	return work_done;
+}
+
+static void tx_agg_submit(struct eth_dev *dev, struct usb_ep *in,
+		struct usb_request *req);
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct sk_buff	*skb = req->context;
-	struct eth_dev	*dev = ep->driver_data;
+	struct sk_buff		*skb = req->context;
+	struct eth_dev		*dev = ep->driver_data;
+	unsigned long		frames = 1;
+	struct usb_request	*next = NULL;
+
+	/* aggregated requests own their buffer and count their frames */
+	if (dev->tx_buf_len) {
+		frames = (unsigned long)req->context;
+		skb = NULL;
+	}
 
 	switch (req->status) {
 	default:
@@ -471,20 +629,170 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	case -ESHUTDOWN:		/* disconnect etc */
 		break;
 	case 0:
-		dev->net->stats.tx_bytes += skb->len;
+		if (skb)
+			dev->net->stats.tx_bytes += skb->len;
 	}
-	dev->net->stats.tx_packets++;
+	dev->net->stats.tx_packets += frames;
 
 	spin_lock(&dev->req_lock);
 	list_add(&req->list, &dev->tx_reqs);
 	spin_unlock(&dev->req_lock);
-	dev_kfree_skb_any(skb);
+
+	/* dev_kfree_skb_irq() does not take NULL; aggregates have no skb */
+	if (skb)
+		dev_kfree_skb_any(skb);
 
 	atomic_dec(&dev->tx_qlen);
+
+	/* whatever was packed while this transfer was in flight goes now */
+	if (dev->tx_buf_len && req->status != -ESHUTDOWN) {
+		spin_lock(&dev->req_lock);
+		next = dev->tx_agg_req;
+		dev->tx_agg_req = NULL;
+		spin_unlock(&dev->req_lock);
+	}
+	if (next)
+		tx_agg_submit(dev, ep, next);
+
 	if (netif_carrier_ok(dev->net))
 		netif_wake_queue(dev->net);
 }
 
+static void tx_agg_submit(struct eth_dev *dev, struct usb_ep *in,
+		struct usb_request *req)
+{
+	unsigned long	frames = (unsigned long)req->context;
+	unsigned long	flags;
+	int		retval;
+
+	req->complete = tx_complete;
+	req->zero = 1;
+	if (!dev->zlp && (req->length % in->maxpacket) == 0)
+		req->length++;
+
+	/* no_interrupt throttling here: completions clock out the
+	 * next aggregate
+	 */
+	req->no_interrupt = 0;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	dev->tx_xfers++;
+	dev->tx_xfer_frames += frames;
+	if (frames > dev->tx_xfer_max)
+		dev->tx_xfer_max = frames;
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	atomic_inc(&dev->tx_qlen);
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	if (retval) {
+		DBG(dev, "tx queue err %d\n", retval);
+		atomic_dec(&dev->tx_qlen);
+		dev->net->stats.tx_dropped += frames;
+		spin_lock_irqsave(&dev->req_lock, flags);
+		if (list_empty(&dev->tx_reqs))
+			netif_start_queue(dev->net);
+		list_add(&req->list, &dev->tx_reqs);
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+	} else {
+		dev->net->trans_start = jiffies;
+	}
+}
+
+/*
+ * Pack wrapped frames back to back into one IN transfer, up to
+ * tx_max_frames of them or max_len bytes.  The aggregate being filled
+ * goes out once it is full, or as soon as no other transfer is in
+ * flight: a completing transfer flushes it from tx_complete(), so
+ * nothing waits for a timer and an idle link sends frames right away.
+ */
+static netdev_tx_t eth_xmit_agg(struct eth_dev *dev, struct sk_buff *skb,
+		struct usb_ep *in, u32 max_len)
+{
+	struct usb_request	*req, *full = NULL;
+	unsigned long		flags;
+	unsigned long		frames;
+	bool			send = false;
+
+	if (dev->wrap) {
+		spin_lock_irqsave(&dev->lock, flags);
+		if (dev->port_usb)
+			skb = dev->wrap(dev->port_usb, skb);
+		spin_unlock_irqrestore(&dev->lock, flags);
+		if (!skb) {
+			dev->net->stats.tx_dropped++;
+			return NETDEV_TX_OK;
+		}
+	}
+
+	if (max_len > dev->tx_buf_len)
+		max_len = dev->tx_buf_len;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req = dev->tx_agg_req;
+	if (req && req->length + skb->len > max_len) {
+		full = req;
+		req = NULL;
+		dev->tx_agg_req = NULL;
+	}
+
+	/* this freelist can be empty after a disconnect(), as in
+	 * eth_start_xmit()
+	 */
+	if (!req && !list_empty(&dev->tx_reqs)) {
+		req = container_of(dev->tx_reqs.next,
+				struct usb_request, list);
+		list_del(&req->list);
+		req->length = 0;
+		req->context = NULL;
+	}
+
+	if (req) {
+		memcpy(req->buf + req->length, skb->data, skb->len);
+		req->length += skb->len;
+		frames = (unsigned long)req->context + 1;
+		req->context = (void *)frames;
+		dev->net->stats.tx_bytes += skb->len;
+
+		if (frames >= dev->tx_max_frames
+				|| req->length + ETH_ZLEN >= max_len
+				|| (!full && !atomic_read(&dev->tx_qlen))) {
+			dev->tx_agg_req = NULL;
+			send = true;
+		} else if (!full) {
+			dev->tx_agg_req = req;
+		}
+	}
+
+	/* temporarily stop TX queue when the freelist empties */
+	if (list_empty(&dev->tx_reqs))
+		netif_stop_queue(dev->net);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	dev_kfree_skb_any(skb);
+
+	/* keep frame order: the new aggregate only becomes visible to
+	 * tx_complete() once the full one has been queued
+	 */
+	if (full) {
+		tx_agg_submit(dev, in, full);
+		if (req && !send) {
+			spin_lock_irqsave(&dev->req_lock, flags);
+			if (atomic_read(&dev->tx_qlen))
+				dev->tx_agg_req = req;
+			else
+				send = true;
+			spin_unlock_irqrestore(&dev->req_lock, flags);
+		}
+	}
+
+	if (!req)
+		dev->net->stats.tx_dropped++;
+	else if (send)
+		tx_agg_submit(dev, in, req);
+
+	return NETDEV_TX_OK;
+}
+
 static inline int is_promisc(u16 cdc_filter)
 {
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
@@ -500,11 +808,13 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	unsigned long		flags;
 	struct usb_ep		*in;
 	u16			cdc_filter;
+	u32			max_len = 0;
 
 	spin_lock_irqsave(&dev->lock, flags);
 	if (dev->port_usb) {
 		in = dev->port_usb->in_ep;
 		cdc_filter = dev->port_usb->cdc_filter;
+		max_len = dev->port_usb->tx_max_len;
 	} else {
 		in = NULL;
 		cdc_filter = 0;
@@ -538,6 +848,9 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	if (dev->tx_buf_len)
+		return eth_xmit_agg(dev, skb, in, max_len);
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -636,6 +949,7 @@ static int eth_open(struct net_device *net)
 	struct gether	*link;
 
 	DBG(dev, "%s\n", __func__);
+	napi_enable(&dev->napi);
 	if (netif_carrier_ok(dev->net))
 		eth_start(dev, GFP_KERNEL);
 
@@ -688,6 +1002,10 @@ static int eth_stop(struct net_device *net)
 	}
 	spin_unlock_irqrestore(&dev->lock, flags);
 
+	napi_disable(&dev->napi);
+	skb_queue_purge(&dev->rx_done);
+	__skb_queue_purge(&dev->rx_frames);
+
 	return 0;
 }
 
@@ -780,6 +1098,7 @@ int __init gether_setup(struct usb_gadget *g, u8 ethaddr[ETH_ALEN])
 	INIT_LIST_HEAD(&dev->rx_reqs);
 
 	skb_queue_head_init(&dev->rx_frames);
+	skb_queue_head_init(&dev->rx_done);
 
 	/* network device setup */
 	dev->net = net;
@@ -796,6 +1115,8 @@ int __init gether_setup(struct usb_gadget *g, u8 ethaddr[ETH_ALEN])
 		memcpy(ethaddr, dev->host_mac, ETH_ALEN);
 
 	net->netdev_ops = &eth_netdev_ops;
+	net->features |= NETIF_F_GRO;
+	netif_napi_add(net, &dev->napi, eth_poll, ETH_NAPI_WEIGHT);
 
 	SET_ETHTOOL_OPS(net, &ops);
 
@@ -895,6 +1216,13 @@ struct net_device *gether_connect(struct gether *link)
 		dev->unwrap = link->unwrap;
 		dev->wrap = link->wrap;
 
+		dev->rx_max_frames = max(link->rx_max_frames, 1U);
+		dev->tx_max_frames = link->tx_max_frames;
+		if (dev->tx_max_frames > 1 && alloc_tx_buffers(dev,
+				dev->tx_max_frames * (ETH_HLEN
+					+ dev->net->mtu + link->header_len)))
+			DBG(dev, "no tx aggregation buffers\n");
+
 		spin_lock(&dev->lock);
 		dev->port_usb = link;
 		link->ioport = dev;
@@ -955,6 +1283,13 @@ void gether_disconnect(struct gether *link)
 	 */
 	usb_ep_disable(link->in_ep);
 	spin_lock(&dev->req_lock);
+	if (dev->tx_agg_req) {
+		list_add(&dev->tx_agg_req->list, &dev->tx_reqs);
+		dev->tx_agg_req = NULL;
+	}
+	if (dev->tx_buf_len)
+		free_tx_buffers(dev, NULL);
+	dev->tx_buf_len = 0;
 	while (!list_empty(&dev->tx_reqs)) {
 		req = container_of(dev->tx_reqs.next,
 					struct usb_request, list);
@@ -62,6 +62,13 @@ struct gether {
 
 	/* hooks for added framing, as needed for RNDIS and EEM. */
 	u32				header_len;
+
+	/* several frames per transfer, if the framing allows it; the
+	 * peer's limit on the size of one IN transfer is tx_max_len
+	 */
+	unsigned			rx_max_frames;
+	unsigned			tx_max_frames;
+	u32				tx_max_len;
 	struct sk_buff			*(*wrap)(struct gether *port,
 						struct sk_buff *skb);
 	int				(*unwrap)(struct gether *port,
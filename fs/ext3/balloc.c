@@ -19,6 +19,8 @@
 #include <linux/ext3_jbd.h>
 #include <linux/quotaops.h>
 #include <linux/buffer_head.h>
+#include <linux/blkdev.h>
+#include <linux/slab.h>
 
 /*
  * balloc.c contains the blocks allocation and deallocation routines
@@ -465,6 +467,118 @@ void ext3_discard_reservation(struct inode *inode)
 	}
 }
 
+/*
+ * Blocks freed with the "discard" mount option are remembered here until
+ * the transaction freeing them has committed; only then is it safe to
+ * tell the device that their contents are no longer needed.
+ */
+struct ext3_free_extent {
+	struct list_head	list;
+	tid_t			tid;
+	ext3_fsblk_t		block;
+	unsigned long		count;
+};
+
+static int ext3_issue_discard(struct super_block *sb, ext3_fsblk_t block,
+			      unsigned long count)
+{
+	sector_t sector = (sector_t)block << (sb->s_blocksize_bits - 9);
+	sector_t nr_sects = (sector_t)count << (sb->s_blocksize_bits - 9);
+
+	/*
+	 * We may be called from kjournald or with a handle held, so no
+	 * fs recursion.  The barrier keeps the discard ahead of any write
+	 * to the blocks once they are reallocated.
+	 */
+	return blkdev_issue_discard(sb->s_bdev, sector, nr_sects, GFP_NOFS,
+				    DISCARD_FL_BARRIER);
+}
+
+static void ext3_discard_add(handle_t *handle, struct super_block *sb,
+			     ext3_fsblk_t block, unsigned long count)
+{
+	struct ext3_sb_info *sbi = EXT3_SB(sb);
+	tid_t tid = handle->h_transaction->t_tid;
+	struct ext3_free_extent *fe;
+
+	spin_lock(&sbi->s_discard_lock);
+	if (!list_empty(&sbi->s_discard_list)) {
+		fe = list_entry(sbi->s_discard_list.prev,
+				struct ext3_free_extent, list);
+		if (fe->tid == tid && fe->block + fe->count == block) {
+			fe->count += count;
+			spin_unlock(&sbi->s_discard_lock);
+			return;
+		}
+	}
+	spin_unlock(&sbi->s_discard_lock);
+
+	/* Failing here only costs us the discard */
+	fe = kmalloc(sizeof(*fe), GFP_NOFS);
+	if (!fe)
+		return;
+	fe->tid = tid;
+	fe->block = block;
+	fe->count = count;
+
+	spin_lock(&sbi->s_discard_lock);
+	list_add_tail(&fe->list, &sbi->s_discard_list);
+	spin_unlock(&sbi->s_discard_lock);
+}
+
+/**
+ * ext3_discard_commit() -- Discard blocks freed by a committed transaction
+ * @journal:		journal the transaction belongs to
+ * @transaction:	transaction whose commit record is on disk
+ *
+ * Called by jbd, before the blocks freed by @transaction can be allocated
+ * again.
+ */
+void ext3_discard_commit(journal_t *journal, transaction_t *transaction)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext3_sb_info *sbi = EXT3_SB(sb);
+	struct ext3_free_extent *fe, *tmp;
+	LIST_HEAD(committed);
+	int err;
+
+	spin_lock(&sbi->s_discard_lock);
+	list_for_each_entry_safe(fe, tmp, &sbi->s_discard_list, list) {
+		if (tid_gt(fe->tid, transaction->t_tid))
+			continue;
+		list_move_tail(&fe->list, &committed);
+	}
+	spin_unlock(&sbi->s_discard_lock);
+
+	list_for_each_entry_safe(fe, tmp, &committed, list) {
+		list_del(&fe->list);
+		if (test_opt(sb, DISCARD)) {
+			err = ext3_issue_discard(sb, fe->block, fe->count);
+			if (err == -EOPNOTSUPP) {
+				ext3_warning(sb, __func__,
+					"discard not supported, disabling");
+				clear_opt(sbi->s_mount_opt, DISCARD);
+			}
+		}
+		kfree(fe);
+	}
+}
+
+/**
+ * ext3_discard_release() -- Forget about blocks still waiting for a commit
+ * @sb:			super block
+ */
+void ext3_discard_release(struct super_block *sb)
+{
+	struct ext3_sb_info *sbi = EXT3_SB(sb);
+	struct ext3_free_extent *fe, *tmp;
+
+	list_for_each_entry_safe(fe, tmp, &sbi->s_discard_list, list) {
+		list_del(&fe->list);
+		kfree(fe);
+	}
+}
+
 /**
  * ext3_free_blocks_sb() -- Free given blocks and update quota
  * @handle:			handle to this transaction
@@ -644,6 +758,9 @@ do_more:
 	if (!err) err = ret;
 	*pdquot_freed_blocks += group_freed;
 
+	if (!err && test_opt(sb, DISCARD))
+		ext3_discard_add(handle, sb, block, count);
+
 	if (overflow && !err) {
 		block += count;
 		count = overflow;
@@ -1880,3 +1997,194 @@ unsigned long ext3_bg_num_gdb(struct super_block *sb, int group)
 	return ext3_bg_num_gdb_meta(sb,group);
 
 }
+
+/**
+ * ext3_trim_all_free() -- Discard the free extents of a block group
+ * @sb:			super block
+ * @group:		block group to trim
+ * @start:		first group relative block to look at
+ * @max:		group relative block to stop at
+ * @minblocks:		smallest extent worth discarding
+ *
+ * Free extents are claimed in the bitmap while they are being discarded
+ * so that nobody allocates them underneath us.  Returns the number of
+ * blocks discarded or a negative error.
+ */
+static ext3_grpblk_t ext3_trim_all_free(struct super_block *sb,
+					unsigned int group,
+					ext3_grpblk_t start, ext3_grpblk_t max,
+					ext3_grpblk_t minblocks)
+{
+	handle_t *handle;
+	ext3_grpblk_t next, bit, freed, count = 0;
+	struct ext3_sb_info *sbi = EXT3_SB(sb);
+	struct buffer_head *gdp_bh, *bitmap_bh = NULL;
+	struct ext3_group_desc *gdp;
+	int err = 0, ret;
+
+	/* We will update one block bitmap and one group descriptor */
+	handle = ext3_journal_start_sb(sb, 2);
+	if (IS_ERR(handle))
+		return PTR_ERR(handle);
+
+	bitmap_bh = read_block_bitmap(sb, group);
+	if (!bitmap_bh) {
+		err = -EIO;
+		goto out;
+	}
+
+	BUFFER_TRACE(bitmap_bh, "getting undo access");
+	err = ext3_journal_get_undo_access(handle, bitmap_bh);
+	if (err)
+		goto out;
+
+	gdp = ext3_get_group_desc(sb, group, &gdp_bh);
+	if (!gdp) {
+		err = -EIO;
+		goto out;
+	}
+
+	BUFFER_TRACE(gdp_bh, "get_write_access");
+	err = ext3_journal_get_write_access(handle, gdp_bh);
+	if (err)
+		goto out;
+
+	while (start < max) {
+		start = bitmap_search_next_usable_block(start, bitmap_bh, max);
+		if (start < 0)
+			break;
+
+		next = start;
+		while (next < max &&
+		       claim_block(sb_bgl_lock(sbi, group), next, bitmap_bh))
+			next++;
+
+		/* Somebody beat us to it */
+		if (next == start) {
+			start++;
+			continue;
+		}
+
+		if (next - start >= minblocks) {
+			err = ext3_issue_discard(sb, start +
+					ext3_group_first_block_no(sb, group),
+					next - start);
+			if (!err)
+				count += next - start;
+		}
+
+		for (bit = start, freed = 0; bit < next; bit++) {
+			BUFFER_TRACE(bitmap_bh, "clear bit");
+			if (!ext3_clear_bit_atomic(sb_bgl_lock(sbi, group),
+						   bit, bitmap_bh->b_data)) {
+				ext3_error(sb, __func__,
+					"bit already cleared for block "E3FSBLK,
+					bit + ext3_group_first_block_no(sb,
+									group));
+				BUFFER_TRACE(bitmap_bh, "bit already cleared");
+			} else {
+				freed++;
+			}
+		}
+		/*
+		 * The blocks were only ever claimed in the bitmap, so the
+		 * group and filesystem free counts never changed; just make
+		 * sure we gave back everything we took.
+		 */
+		WARN_ON(freed != next - start);
+
+		start = next;
+		if (err) {
+			if (err != -EOPNOTSUPP)
+				ext3_warning(sb, __func__,
+					"discard returned error %d", err);
+			break;
+		}
+
+		if (fatal_signal_pending(current)) {
+			err = -ERESTARTSYS;
+			break;
+		}
+		cond_resched();
+	}
+
+	/* We dirtied the bitmap block */
+	BUFFER_TRACE(bitmap_bh, "dirtied bitmap block");
+	ret = ext3_journal_dirty_metadata(handle, bitmap_bh);
+	if (!err)
+		err = ret;
+
+	/* And the group descriptor block */
+	BUFFER_TRACE(gdp_bh, "dirtied group descriptor block");
+	ret = ext3_journal_dirty_metadata(handle, gdp_bh);
+	if (!err)
+		err = ret;
+
+	ext3_debug("trimmed %d blocks in group %u\n", count, group);
+out:
+	ext3_journal_stop(handle);
+	brelse(bitmap_bh);
+	return err ? err : count;
+}
+
+/**
+ * ext3_trim_fs() -- Discard free blocks in a range of the filesystem
+ * @sb:			super block
+ * @range:		byte range to trim and the smallest extent to bother
+ *			with; on return range->len holds the bytes discarded
+ *
+ * This is the FITRIM ioctl, for filesystems not mounted with "discard"
+ * that want to tell the device about their free space periodically.
+ */
+int ext3_trim_fs(struct super_block *sb, struct fstrim_range *range)
+{
+	struct ext3_super_block *es = EXT3_SB(sb)->s_es;
+	ext3_fsblk_t first_data = le32_to_cpu(es->s_first_data_block);
+	ext3_fsblk_t blocks_count = le32_to_cpu(es->s_blocks_count);
+	ext3_fsblk_t start, end;
+	ext3_grpblk_t first, last, minlen;
+	unsigned long group, last_group;
+	u64 trimmed = 0;
+	int ret = 0;
+
+	if (range->minlen >> sb->s_blocksize_bits > EXT3_BLOCKS_PER_GROUP(sb))
+		return -EINVAL;
+	minlen = max_t(ext3_grpblk_t, range->minlen >> sb->s_blocksize_bits, 1);
+
+	if (range->start >> sb->s_blocksize_bits >= blocks_count - first_data)
+		goto out;
+	start = (range->start >> sb->s_blocksize_bits) + first_data;
+	end = blocks_count;
+	if ((range->len >> sb->s_blocksize_bits) < end - start)
+		end = start + (range->len >> sb->s_blocksize_bits);
+	if (end <= start)
+		goto out;
+
+	group = (start - first_data) / EXT3_BLOCKS_PER_GROUP(sb);
+	first = (start - first_data) % EXT3_BLOCKS_PER_GROUP(sb);
+	last_group = (end - 1 - first_data) / EXT3_BLOCKS_PER_GROUP(sb);
+
+	for (; group <= last_group; group++, first = 0) {
+		struct ext3_group_desc *gdp;
+
+		gdp = ext3_get_group_desc(sb, group, NULL);
+		if (!gdp)
+			break;
+		if (le16_to_cpu(gdp->bg_free_blocks_count) < minlen)
+			continue;
+
+		if (group == last_group)
+			last = end - ext3_group_first_block_no(sb, group);
+		else
+			last = EXT3_BLOCKS_PER_GROUP(sb);
+
+		ret = ext3_trim_all_free(sb, group, first, last, minlen);
+		if (ret < 0)
+			break;
+		trimmed += ret;
+		ret = 0;
+	}
+out:
+	range->len = trimmed << sb->s_blocksize_bits;
+	return ret;
+}
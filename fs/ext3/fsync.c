@@ -80,6 +80,7 @@ int ext3_sync_file(struct file * file, struct dentry *dentry, int datasync)
 	else
 		commit_tid = atomic_read(&ei->i_sync_tid);
 
+	log_batch_commit(journal, commit_tid);
 	if (log_start_commit(journal, commit_tid)) {
 		log_wait_commit(journal, commit_tid);
 		goto out;
@@ -15,6 +15,7 @@
 #include <linux/mount.h>
 #include <linux/time.h>
 #include <linux/compat.h>
+#include <linux/blkdev.h>
 #include <asm/uaccess.h>
 
 long ext3_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
@@ -276,7 +277,37 @@ group_add_out:
 		mnt_drop_write(filp->f_path.mnt);
 		return err;
 	}
+	case FITRIM: {
+		struct super_block *sb = inode->i_sb;
+		struct request_queue *q = bdev_get_queue(sb->s_bdev);
+		struct fstrim_range range;
+		int err;
+
+		if (!capable(CAP_SYS_ADMIN))
+			return -EPERM;
+
+		if (!blk_queue_discard(q))
+			return -EOPNOTSUPP;
 
+		if (copy_from_user(&range, (struct fstrim_range __user *)arg,
+				sizeof(range)))
+			return -EFAULT;
+
+		err = mnt_want_write(filp->f_path.mnt);
+		if (err)
+			return err;
+
+		err = ext3_trim_fs(sb, &range);
+		mnt_drop_write(filp->f_path.mnt);
+		if (err < 0)
+			return err;
+
+		if (copy_to_user((struct fstrim_range __user *)arg, &range,
+				sizeof(range)))
+			return -EFAULT;
+
+		return 0;
+	}
 
 	default:
 		return -ENOTTY;
@@ -321,6 +352,7 @@ long ext3_compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		cmd = EXT3_IOC_SETRSVSZ;
 		break;
 	case EXT3_IOC_GROUP_ADD:
+	case FITRIM:
 		break;
 	default:
 		return -ENOIOCTLCMD;
@@ -405,6 +405,7 @@ static void ext3_put_super (struct super_block * sb)
 	sbi->s_journal = NULL;
 	if (err < 0)
 		ext3_abort(sb, __func__, "Couldn't clean up the journal");
+	ext3_discard_release(sb);
 
 	if (!(sb->s_flags & MS_RDONLY)) {
 		EXT3_CLEAR_INCOMPAT_FEATURE(sb, EXT3_FEATURE_INCOMPAT_RECOVER);
@@ -635,6 +636,12 @@ static int ext3_show_options(struct seq_file *seq, struct vfsmount *vfs)
 						     EXT3_MOUNT_DATA_FLAGS));
 	if (test_opt(sb, DATA_ERR_ABORT))
 		seq_puts(seq, ",data_err=abort");
+	if (test_opt(sb, DISCARD))
+		seq_puts(seq, ",discard");
+	if (test_opt(sb, JOURNAL_ASYNC_COMMIT))
+		seq_puts(seq, ",journal_async_commit");
+	else if (test_opt(sb, JOURNAL_CHECKSUM))
+		seq_puts(seq, ",journal_checksum");
 
 	ext3_show_quota_options(seq, sb);
 
@@ -789,7 +796,8 @@ enum {
 	Opt_usrjquota, Opt_grpjquota, Opt_offusrjquota, Opt_offgrpjquota,
 	Opt_jqfmt_vfsold, Opt_jqfmt_vfsv0, Opt_quota, Opt_noquota,
 	Opt_ignore, Opt_barrier, Opt_err, Opt_resize, Opt_usrquota,
-	Opt_grpquota
+	Opt_grpquota, Opt_discard, Opt_nodiscard,
+	Opt_journal_checksum, Opt_journal_async_commit
 };
 
 static const match_table_t tokens = {
@@ -842,6 +850,10 @@ static const match_table_t tokens = {
 	{Opt_usrquota, "usrquota"},
 	{Opt_barrier, "barrier=%u"},
 	{Opt_resize, "resize"},
+	{Opt_discard, "discard"},
+	{Opt_nodiscard, "nodiscard"},
+	{Opt_journal_checksum, "journal_checksum"},
+	{Opt_journal_async_commit, "journal_async_commit"},
 	{Opt_err, NULL},
 };
 
@@ -1199,6 +1211,19 @@ set_qf_format:
 		case Opt_bh:
 			clear_opt(sbi->s_mount_opt, NOBH);
 			break;
+		case Opt_discard:
+			set_opt(sbi->s_mount_opt, DISCARD);
+			break;
+		case Opt_nodiscard:
+			clear_opt(sbi->s_mount_opt, DISCARD);
+			break;
+		case Opt_journal_checksum:
+			set_opt(sbi->s_mount_opt, JOURNAL_CHECKSUM);
+			break;
+		case Opt_journal_async_commit:
+			set_opt(sbi->s_mount_opt, JOURNAL_ASYNC_COMMIT);
+			set_opt(sbi->s_mount_opt, JOURNAL_CHECKSUM);
+			break;
 		default:
 			printk (KERN_ERR
 				"EXT3-fs: Unrecognized mount option \"%s\" "
@@ -1890,6 +1915,8 @@ static int ext3_fill_super (struct super_block *sb, void *data, int silent)
 	sb->dq_op = &ext3_quota_operations;
 #endif
 	INIT_LIST_HEAD(&sbi->s_orphan); /* unlinked but open files */
+	spin_lock_init(&sbi->s_discard_lock);
+	INIT_LIST_HEAD(&sbi->s_discard_list); /* freed, awaiting commit */
 
 	sb->s_root = NULL;
 
@@ -1916,6 +1943,21 @@ static int ext3_fill_super (struct super_block *sb, void *data, int silent)
 		goto failed_mount3;
 	}
 
+	if (test_opt(sb, JOURNAL_ASYNC_COMMIT)) {
+		journal_set_features(sbi->s_journal,
+				JFS_FEATURE_COMPAT_CHECKSUM, 0,
+				JFS_FEATURE_INCOMPAT_ASYNC_COMMIT);
+	} else if (test_opt(sb, JOURNAL_CHECKSUM)) {
+		journal_set_features(sbi->s_journal,
+				JFS_FEATURE_COMPAT_CHECKSUM, 0, 0);
+		journal_clear_features(sbi->s_journal, 0, 0,
+				JFS_FEATURE_INCOMPAT_ASYNC_COMMIT);
+	} else {
+		journal_clear_features(sbi->s_journal,
+				JFS_FEATURE_COMPAT_CHECKSUM, 0,
+				JFS_FEATURE_INCOMPAT_ASYNC_COMMIT);
+	}
+
 	/* We have now updated the journal if required, so we can
 	 * validate the data journaling mode. */
 	switch (test_opt(sb, DATA_FLAGS)) {
@@ -2052,6 +2094,8 @@ static void ext3_init_journal_params(struct super_block *sb, journal_t *journal)
 	else
 		journal->j_flags &= ~JFS_ABORT_ON_SYNCDATA_ERR;
 	spin_unlock(&journal->j_state_lock);
+
+	journal->j_commit_callback = ext3_discard_commit;
 }
 
 static journal_t *ext3_get_journal(struct super_block *sb,
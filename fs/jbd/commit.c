@@ -21,6 +21,8 @@
 #include <linux/mm.h>
 #include <linux/pagemap.h>
 #include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/crc32.h>
 
 /*
  * Default IO end handler for temporary BJ_IO buffer_heads.
@@ -106,21 +108,25 @@ static int inverted_lock(journal_t *journal, struct buffer_head *bh)
 	return 1;
 }
 
-/* Done it all: now write the commit record.  We should have
+/*
+ * Done it all: now submit the commit record.  We should have
  * cleaned up our previous buffers by now, so if we are in abort
  * mode we can now just skip the rest of the journal write
  * entirely.
  *
  * Returns 1 if the journal needs to be aborted or 0 on success
  */
-static int journal_write_commit_record(journal_t *journal,
-					transaction_t *commit_transaction)
+static int journal_submit_commit_record(journal_t *journal,
+					transaction_t *commit_transaction,
+					struct buffer_head **cbh,
+					__u32 crc32_sum)
 {
 	struct journal_head *descriptor;
+	struct commit_header *tmp;
 	struct buffer_head *bh;
-	journal_header_t *header;
 	int ret;
 	int barrier_done = 0;
+	struct timespec now = current_kernel_time();
 
 	if (is_journal_aborted(journal))
 		return 0;
@@ -131,20 +137,39 @@ static int journal_write_commit_record(journal_t *journal,
 
 	bh = jh2bh(descriptor);
 
-	header = (journal_header_t *)(bh->b_data);
-	header->h_magic = cpu_to_be32(JFS_MAGIC_NUMBER);
-	header->h_blocktype = cpu_to_be32(JFS_COMMIT_BLOCK);
-	header->h_sequence = cpu_to_be32(commit_transaction->t_tid);
+	tmp = (struct commit_header *)bh->b_data;
+	tmp->h_magic = cpu_to_be32(JFS_MAGIC_NUMBER);
+	tmp->h_blocktype = cpu_to_be32(JFS_COMMIT_BLOCK);
+	tmp->h_sequence = cpu_to_be32(commit_transaction->t_tid);
+	tmp->h_commit_sec = cpu_to_be64(now.tv_sec);
+	tmp->h_commit_nsec = cpu_to_be32(now.tv_nsec);
+
+	if (JFS_HAS_COMPAT_FEATURE(journal, JFS_FEATURE_COMPAT_CHECKSUM)) {
+		tmp->h_chksum_type	= JFS_CRC32_CHKSUM;
+		tmp->h_chksum_size	= JFS_CRC32_CHKSUM_SIZE;
+		tmp->h_chksum[0]	= cpu_to_be32(crc32_sum);
+	}
+
+	JBUFFER_TRACE(descriptor, "submit commit block");
+	lock_buffer(bh);
+	clear_buffer_dirty(bh);
+	set_buffer_uptodate(bh);
+	bh->b_end_io = journal_end_buffer_io_sync;
 
-	JBUFFER_TRACE(descriptor, "write commit block");
-	set_buffer_dirty(bh);
-	if (journal->j_flags & JFS_BARRIER) {
+	/*
+	 * An async commit record is protected by its checksum rather than
+	 * by ordering, the flush after it covers the whole transaction.
+	 */
+	if (journal->j_flags & JFS_BARRIER &&
+	    !JFS_HAS_INCOMPAT_FEATURE(journal,
+				      JFS_FEATURE_INCOMPAT_ASYNC_COMMIT)) {
 		set_buffer_ordered(bh);
 		barrier_done = 1;
 	}
-	ret = sync_dirty_buffer(bh);
+	ret = submit_bh(WRITE_SYNC_PLUG, bh);
 	if (barrier_done)
 		clear_buffer_ordered(bh);
+
 	/* is it possible for another commit to fail at roughly
 	 * the same time as this one?  If so, we don't want to
 	 * trust the barrier flag in the super, but instead want
@@ -162,14 +187,72 @@ static int journal_write_commit_record(journal_t *journal,
 		spin_unlock(&journal->j_state_lock);
 
 		/* And try again, without the barrier */
+		lock_buffer(bh);
 		set_buffer_uptodate(bh);
-		set_buffer_dirty(bh);
-		ret = sync_dirty_buffer(bh);
+		clear_buffer_dirty(bh);
+		ret = submit_bh(WRITE_SYNC_PLUG, bh);
 	}
+	*cbh = bh;
+	return ret == -EIO;
+}
+
+/*
+ * This function along with journal_submit_commit_record
+ * allows to write the commit record asynchronously.
+ */
+static int journal_wait_on_commit_record(journal_t *journal,
+					 struct buffer_head *bh)
+{
+	int ret = 0;
+
+retry:
+	clear_buffer_dirty(bh);
+	wait_on_buffer(bh);
+	if (buffer_eopnotsupp(bh) && (journal->j_flags & JFS_BARRIER)) {
+		char b[BDEVNAME_SIZE];
+
+		printk(KERN_WARNING
+			"JBD: wait_on_commit_record: sync failed on %s - "
+			"disabling barriers\n",
+			bdevname(journal->j_dev, b));
+		spin_lock(&journal->j_state_lock);
+		journal->j_flags &= ~JFS_BARRIER;
+		spin_unlock(&journal->j_state_lock);
+
+		lock_buffer(bh);
+		clear_buffer_dirty(bh);
+		set_buffer_uptodate(bh);
+		bh->b_end_io = journal_end_buffer_io_sync;
+
+		ret = submit_bh(WRITE_SYNC_PLUG, bh);
+		if (ret) {
+			unlock_buffer(bh);
+			goto out;
+		}
+		goto retry;
+	}
+
+	if (unlikely(!buffer_uptodate(bh)))
+		ret = -EIO;
+out:
 	put_bh(bh);		/* One for getblk() */
-	journal_put_journal_head(descriptor);
+	journal_put_journal_head(bh2jh(bh));
 
-	return (ret == -EIO);
+	return ret;
+}
+
+static __u32 journal_checksum_data(__u32 crc32_sum, struct buffer_head *bh)
+{
+	struct page *page = bh->b_page;
+	char *addr;
+	__u32 checksum;
+
+	addr = kmap_atomic(page, KM_USER0);
+	checksum = crc32_be(crc32_sum,
+		(void *)(addr + offset_in_page(bh->b_data)), bh->b_size);
+	kunmap_atomic(addr, KM_USER0);
+
+	return checksum;
 }
 
 static void journal_do_submit_data(struct buffer_head **wbuf, int bufs,
@@ -319,6 +402,9 @@ void journal_commit_transaction(journal_t *journal)
 	int tag_flag;
 	int i;
 	int write_op = WRITE;
+	struct blk_plug plug;
+	struct buffer_head *cbh = NULL; /* For transactional checksums */
+	__u32 crc32_sum = ~0;
 
 	/*
 	 * First job: lock down the current transaction and wait for
@@ -442,8 +528,10 @@ void journal_commit_transaction(journal_t *journal)
 	 * Now start flushing things to disk, in the order they appear
 	 * on the transaction lists.  Data blocks go first.
 	 */
+	blk_start_plug(&plug);
 	err = journal_submit_data_buffers(journal, commit_transaction,
 					  write_op);
+	blk_finish_plug(&plug);
 
 	/*
 	 * Wait for all previously submitted IO to complete.
@@ -504,6 +592,8 @@ void journal_commit_transaction(journal_t *journal)
 		err = 0;
 	}
 
+	blk_start_plug(&plug);
+
 	journal_write_revoke_records(journal, commit_transaction, write_op);
 
 	/*
@@ -670,6 +760,15 @@ void journal_commit_transaction(journal_t *journal)
 start_journal_io:
 			for (i = 0; i < bufs; i++) {
 				struct buffer_head *bh = wbuf[i];
+				/*
+				 * Compute checksum.
+				 */
+				if (JFS_HAS_COMPAT_FEATURE(journal,
+					JFS_FEATURE_COMPAT_CHECKSUM)) {
+					crc32_sum =
+					    journal_checksum_data(crc32_sum, bh);
+				}
+
 				lock_buffer(bh);
 				clear_buffer_dirty(bh);
 				set_buffer_uptodate(bh);
@@ -685,6 +784,22 @@ start_journal_io:
 		}
 	}
 
+	blk_finish_plug(&plug);
+
+	/*
+	 * With async commit the checksummed commit record goes out along
+	 * with the rest of the transaction, and one cache flush once it
+	 * has all been submitted replaces the barrier on the commit block.
+	 */
+	if (JFS_HAS_INCOMPAT_FEATURE(journal,
+				     JFS_FEATURE_INCOMPAT_ASYNC_COMMIT)) {
+		if (journal_submit_commit_record(journal, commit_transaction,
+						 &cbh, crc32_sum))
+			err = -EIO;
+		if (journal->j_flags & JFS_BARRIER)
+			blkdev_issue_flush(journal->j_dev, NULL);
+	}
+
 	/* Lo and behold: we have just managed to send a transaction to
            the log.  Before we can commit it, wait for the IO so far to
            complete.  Control buffers being written are on the
@@ -787,12 +902,26 @@ wait_for_iobuf:
 
 	jbd_debug(3, "JBD: commit phase 6\n");
 
-	if (journal_write_commit_record(journal, commit_transaction))
+	if (!JFS_HAS_INCOMPAT_FEATURE(journal,
+				      JFS_FEATURE_INCOMPAT_ASYNC_COMMIT)) {
+		if (journal_submit_commit_record(journal, commit_transaction,
+						 &cbh, crc32_sum))
+			err = -EIO;
+	}
+	if (cbh && journal_wait_on_commit_record(journal, cbh))
 		err = -EIO;
 
 	if (err)
 		journal_abort(journal, err);
 
+	/*
+	 * The blocks freed by this transaction are now free for good, but
+	 * cannot be handed out again until the t_forget buffers below drop
+	 * their committed data, so this is the place to discard them.
+	 */
+	if (journal->j_commit_callback && !is_journal_aborted(journal))
+		journal->j_commit_callback(journal, commit_transaction);
+
 	/* End of a transaction!  Finally, we can do checkpoint
            processing: any buffers committed as a result of this
            transaction can be removed from any checkpoint list it was on
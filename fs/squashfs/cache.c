@@ -23,17 +23,20 @@
 
 /*
  * Blocks in Squashfs are compressed.  To avoid repeatedly decompressing
- * recently accessed data Squashfs uses two small metadata and fragment caches.
+ * recently accessed data Squashfs uses small metadata, fragment and datablock
+ * caches.  When a cache is full the least recently used entry is reused.
  *
- * This file implements a generic cache implementation used for both caches,
+ * This file implements a generic cache implementation used for all caches,
  * plus functions layered ontop of the generic cache implementation to
  * access the metadata and fragment caches.
  *
  * To avoid out of memory and fragmentation isssues with vmalloc the cache
  * uses sequences of kmalloced PAGE_CACHE_SIZE buffers.
  *
- * It should be noted that the cache is not used for file datablocks, these
- * are decompressed and cached in the page-cache in the normal way.  The
+ * It should be noted that file datablocks are cached in the page-cache in
+ * the normal way, the datablock cache only holds the last few decompressed
+ * blocks so a block isn't decompressed twice when pages of it are read
+ * again soon after (or by another process at the same time).  Otherwise the
  * cache is only used to temporarily cache fragment and metadata blocks
  * which have been read as as a result of a metadata (i.e. inode or
  * directory) or fragment access.  Because metadata and fragments are packed
@@ -91,18 +94,18 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 			}
 
 			/*
-			 * At least one unused cache entry.  A simple
-			 * round-robin strategy is used to choose the entry to
-			 * be evicted from the cache.
+			 * At least one unused cache entry.  Evict the one
+			 * released longest ago.
 			 */
-			i = cache->next_blk;
+			i = -1;
 			for (n = 0; n < cache->entries; n++) {
-				if (cache->entry[i].refcount == 0)
-					break;
-				i = (i + 1) % cache->entries;
+				if (cache->entry[n].refcount)
+					continue;
+				if (i == -1 || (long) (cache->entry[n].lru -
+						cache->entry[i].lru) < 0)
+					i = n;
 			}
 
-			cache->next_blk = (i + 1) % cache->entries;
 			entry = &cache->entry[i];
 
 			/*
@@ -188,6 +191,7 @@ void squashfs_cache_put(struct squashfs_cache_entry *entry)
 	spin_lock(&cache->lock);
 	entry->refcount--;
 	if (entry->refcount == 0) {
+		entry->lru = ++cache->lru_clock;
 		cache->unused++;
 		/*
 		 * If there's any processes waiting for a block to become
@@ -247,7 +251,6 @@ struct squashfs_cache *squashfs_cache_init(char *name, int entries,
 		goto cleanup;
 	}
 
-	cache->next_blk = 0;
 	cache->unused = entries;
 	cache->entries = entries;
 	cache->block_size = block_size;
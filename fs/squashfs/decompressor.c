@@ -0,0 +1,152 @@
+/*
+ * Squashfs - a compressed read only filesystem for Linux
+ *
+ * Copyright (c) 2002, 2003, 2004, 2005, 2006, 2007, 2008, 2009
+ * Phillip Lougher <phillip@lougher.demon.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * decompressor.c
+ */
+
+/*
+ * This file selects the decompressor named in the superblock and looks
+ * after the per-cpu decompressor streams.
+ */
+
+#include <linux/types.h>
+#include <linux/percpu.h>
+#include <linux/buffer_head.h>
+
+#include "squashfs_fs.h"
+#include "squashfs_fs_sb.h"
+#include "squashfs_fs_i.h"
+#include "decompressor.h"
+#include "squashfs.h"
+
+static const struct squashfs_decompressor squashfs_lzma_unsupported_comp_ops = {
+	.id = LZMA_COMPRESSION,
+	.name = "lzma",
+	.supported = 0
+};
+
+#ifndef CONFIG_SQUASHFS_LZO
+static const struct squashfs_decompressor squashfs_lzo_unsupported_comp_ops = {
+	.id = LZO_COMPRESSION,
+	.name = "lzo",
+	.supported = 0
+};
+#endif
+
+static const struct squashfs_decompressor squashfs_unknown_comp_ops = {
+	.id = 0,
+	.name = "unknown",
+	.supported = 0
+};
+
+static const struct squashfs_decompressor *decompressor[] = {
+	&squashfs_zlib_comp_ops,
+	&squashfs_lzma_unsupported_comp_ops,
+#ifdef CONFIG_SQUASHFS_LZO
+	&squashfs_lzo_comp_ops,
+#else
+	&squashfs_lzo_unsupported_comp_ops,
+#endif
+	&squashfs_unknown_comp_ops
+};
+
+
+const struct squashfs_decompressor *squashfs_lookup_decompressor(int id)
+{
+	int i;
+
+	for (i = 0; decompressor[i]->id; i++)
+		if (id == decompressor[i]->id)
+			break;
+
+	return decompressor[i];
+}
+
+
+/*
+ * Allocate a decompressor stream for every possible cpu.  The streams
+ * are sized from msblk->block_size, so this must be called after the
+ * superblock has been checked.
+ */
+int squashfs_decompressor_init(struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream *stream;
+	int cpu;
+
+	msblk->stream = alloc_percpu(struct squashfs_stream);
+	if (msblk->stream == NULL)
+		goto failed;
+
+	for_each_possible_cpu(cpu) {
+		stream = per_cpu_ptr(msblk->stream, cpu);
+		stream->stream = msblk->decompressor->init(msblk);
+		if (stream->stream == NULL)
+			goto failed;
+	}
+
+	return 0;
+
+failed:
+	ERROR("Failed to allocate %s decompressor\n",
+		msblk->decompressor->name);
+	squashfs_decompressor_free(msblk);
+	return -ENOMEM;
+}
+
+
+void squashfs_decompressor_free(struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream *stream;
+	int cpu;
+
+	if (msblk->stream == NULL)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		stream = per_cpu_ptr(msblk->stream, cpu);
+		if (stream->stream)
+			msblk->decompressor->free(stream->stream);
+	}
+
+	free_percpu(msblk->stream);
+	msblk->stream = NULL;
+}
+
+
+/*
+ * Decompress the block held in bh[0..b-1] into buffer using this cpu's
+ * stream.  The buffer heads must already be up to date, decompressors
+ * do not sleep, so preemption is simply disabled while the stream is
+ * in use.
+ */
+int squashfs_decompress(struct squashfs_sb_info *msblk, void **buffer,
+	struct buffer_head **bh, int b, int offset, int length, int srclength,
+	int pages)
+{
+	struct squashfs_stream *stream;
+	int res;
+
+	stream = per_cpu_ptr(msblk->stream, get_cpu());
+	res = msblk->decompressor->decompress(msblk, stream->stream, buffer,
+		bh, b, offset, length, srclength, pages);
+	put_cpu();
+
+	return res;
+}
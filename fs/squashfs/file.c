@@ -410,6 +410,17 @@ static int squashfs_readpage(struct file *file, struct page *page)
 				 msblk->block_size;
 			sparse = 1;
 		} else {
+			/*
+			 * If the file is being read sequentially, start
+			 * reading this and the following datablock in one
+			 * go, so the next block is already on its way from
+			 * disk while this one is decompressed.
+			 */
+			if (file && file->f_ra.ra_pages && index + 1 < file_end)
+				squashfs_read_ahead(inode->i_sb, block,
+					SQUASHFS_COMPRESSED_SIZE_BLOCK(bsize) +
+					msblk->block_size);
+
 			/*
 			 * Read and decompress datablock.
 			 */
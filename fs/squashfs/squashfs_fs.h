@@ -24,6 +24,7 @@
  */
 
 #define SQUASHFS_CACHED_FRAGMENTS	CONFIG_SQUASHFS_FRAGMENT_CACHE_SIZE
+#define SQUASHFS_CACHED_DATA		CONFIG_SQUASHFS_DATA_CACHE_SIZE
 #define SQUASHFS_MAJOR			4
 #define SQUASHFS_MINOR			0
 #define SQUASHFS_START			0
@@ -212,6 +213,8 @@ struct meta_index {
  * definitions for structures on disk
  */
 #define ZLIB_COMPRESSION	 1
+#define LZMA_COMPRESSION	 2
+#define LZO_COMPRESSION		 3
 
 struct squashfs_super_block {
 	__le32			s_magic;
@@ -28,7 +28,7 @@
 struct squashfs_cache {
 	char			*name;
 	int			entries;
-	int			next_blk;
+	unsigned long		lru_clock;
 	int			num_waiters;
 	int			unused;
 	int			block_size;
@@ -42,6 +42,7 @@ struct squashfs_cache_entry {
 	u64			block;
 	int			length;
 	int			refcount;
+	unsigned long		lru;
 	u64			next_index;
 	int			pending;
 	int			error;
@@ -52,6 +53,7 @@ struct squashfs_cache_entry {
 };
 
 struct squashfs_sb_info {
+	const struct squashfs_decompressor	*decompressor;
 	int			devblksize;
 	int			devblksize_log2;
 	struct squashfs_cache	*block_cache;
@@ -61,10 +63,9 @@ struct squashfs_sb_info {
 	__le64			*id_table;
 	__le64			*fragment_index;
 	unsigned int		*fragment_index_2;
-	struct mutex		read_data_mutex;
 	struct mutex		meta_index_mutex;
 	struct meta_index	*meta_index;
-	z_stream		stream;
+	struct squashfs_stream	*stream;
 	__le64			*inode_lookup_table;
 	u64			inode_table;
 	u64			directory_table;
@@ -193,6 +193,10 @@ struct request {
 
 	struct gendisk *rq_disk;
 	unsigned long start_time;
+#ifdef CONFIG_BLK_LATENCY_HIST
+	u64 start_time_ns;
+	u64 io_start_time_ns;	/* when handed to the driver */
+#endif
 
 	/* Number of scatter-gather DMA addr+len pairs after
 	 * physical address coalescing is performed.
@@ -321,6 +325,39 @@ struct queue_limits {
 	unsigned char		no_cluster;
 };
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+/*
+ * Request latency, bucketed by powers of two of microseconds.  Bucket
+ * i counts latencies below 2^i usecs, the last one everything else.
+ */
+#define BLK_LAT_BUCKETS		24
+
+enum {
+	BLK_LAT_READ,
+	BLK_LAT_WRITE,
+	BLK_LAT_SYNC,		/* sync writes */
+	BLK_LAT_FLUSH,		/* barriers and their flushes */
+	BLK_LAT_NR_CLASSES,
+};
+
+enum {
+	BLK_LAT_QUEUE,		/* allocation to dispatch (Q2D) */
+	BLK_LAT_DEVICE,		/* dispatch to completion (D2C) */
+	BLK_LAT_TOTAL,		/* allocation to completion (Q2C) */
+	BLK_LAT_NR_PHASES,
+};
+
+struct blk_latency_stat {
+	u64			min, max, total;	/* usecs */
+	unsigned long		nr;
+	unsigned long		hist[BLK_LAT_BUCKETS];
+};
+
+struct blk_latency {
+	struct blk_latency_stat	stat[BLK_LAT_NR_CLASSES][BLK_LAT_NR_PHASES];
+};
+#endif
+
 struct request_queue
 {
 	/*
@@ -424,6 +461,9 @@ struct request_queue
 	int			node;
 #ifdef CONFIG_BLK_DEV_IO_TRACE
 	struct blk_trace	*blk_trace;
+#endif
+#ifdef CONFIG_BLK_LATENCY_HIST
+	struct blk_latency	latency;
 #endif
 	/*
 	 * reserved for flush operations
@@ -847,6 +887,29 @@ static inline void blk_run_address_space(struct address_space *mapping)
 		blk_run_backing_dev(mapping->backing_dev_info, NULL);
 }
 
+/*
+ * On-stack plugging.  Between blk_start_plug() and blk_finish_plug() the
+ * requests a task submits are kept on a private list, where later bios
+ * can be merged into them without taking the queue lock.  They are moved
+ * to their queues in one go, and the queues run at once, when the plug
+ * is finished or the task goes to sleep, instead of waiting for the
+ * queue's unplug timer.
+ */
+struct blk_plug {
+	struct list_head list;
+};
+
+extern void blk_start_plug(struct blk_plug *);
+extern void blk_finish_plug(struct blk_plug *);
+extern void blk_flush_plug(struct task_struct *);
+
+static inline bool blk_needs_flush_plug(struct task_struct *tsk)
+{
+	struct blk_plug *plug = tsk->plug;
+
+	return plug && !list_empty(&plug->list);
+}
+
 /*
  * blk_rq_pos()			: the current sector
  * blk_rq_bytes()		: bytes left in the entire request
@@ -1301,6 +1364,28 @@ static inline long nr_blockdev_pages(void)
 	return 0;
 }
 
+struct task_struct;
+
+struct blk_plug {
+};
+
+static inline void blk_start_plug(struct blk_plug *plug)
+{
+}
+
+static inline void blk_finish_plug(struct blk_plug *plug)
+{
+}
+
+static inline void blk_flush_plug(struct task_struct *tsk)
+{
+}
+
+static inline bool blk_needs_flush_plug(struct task_struct *tsk)
+{
+	return false;
+}
+
 #endif /* CONFIG_BLOCK */
 
 #endif
@@ -10,6 +10,15 @@
 
 extern u32  crc32_le(u32 crc, unsigned char const *p, size_t len);
 extern u32  crc32_be(u32 crc, unsigned char const *p, size_t len);
+extern u32  __crc32c_le(u32 crc, unsigned char const *p, size_t len);
+
+/*
+ * Join the crcs of two adjacent buffers: @crc2 must have been computed
+ * with a seed of 0, and the result is the crc of both buffers with the
+ * seed used for @crc1.
+ */
+extern u32  crc32_le_combine(u32 crc1, u32 crc2, size_t len2);
+extern u32  __crc32c_le_combine(u32 crc1, u32 crc2, size_t len2);
 
 #define crc32(seed, data, length)  crc32_le(seed, (unsigned char const *)data, length)
 
@@ -414,6 +414,9 @@ struct ext3_inode {
 #define EXT3_MOUNT_GRPQUOTA		0x200000 /* "old" group quota */
 #define EXT3_MOUNT_DATA_ERR_ABORT	0x400000 /* Abort on file data write
 						  * error in ordered mode */
+#define EXT3_MOUNT_DISCARD		0x800000 /* Discard freed blocks */
+#define EXT3_MOUNT_JOURNAL_CHECKSUM	0x1000000 /* Journal checksums */
+#define EXT3_MOUNT_JOURNAL_ASYNC_COMMIT	0x2000000 /* Journal Async Commit */
 
 /* Compatibility, for having both ext2_fs.h and ext3_fs.h included at once */
 #ifndef _LINUX_EXT2_FS_H
@@ -838,6 +841,9 @@ extern struct ext3_group_desc * ext3_get_group_desc(struct super_block * sb,
 						    unsigned int block_group,
 						    struct buffer_head ** bh);
 extern int ext3_should_retry_alloc(struct super_block *sb, int *retries);
+extern void ext3_discard_commit(journal_t *journal, transaction_t *transaction);
+extern void ext3_discard_release(struct super_block *sb);
+extern int ext3_trim_fs(struct super_block *sb, struct fstrim_range *range);
 extern void ext3_init_block_alloc_info(struct inode *);
 extern void ext3_rsv_window_add(struct super_block *sb, struct ext3_reserve_window_node *rsv);
 
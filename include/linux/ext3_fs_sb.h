@@ -72,6 +72,8 @@ struct ext3_sb_info {
 	struct inode * s_journal_inode;
 	struct journal_s * s_journal;
 	struct list_head s_orphan;
+	spinlock_t s_discard_lock;
+	struct list_head s_discard_list; /* Freed extents to discard at commit */
 	unsigned long s_commit_interval;
 	struct block_device *journal_bdev;
 #ifdef CONFIG_JBD_DEBUG
@@ -30,6 +30,21 @@ struct input_event {
 	__s32 value;
 };
 
+/*
+ * Event ring of an evdev client, mapped with mmap() at offset 0 of the
+ * event device; EVIOCGRINGSIZE returns the length to map.  The kernel
+ * only advances @head once a whole packet (up to EV_SYN/SYN_REPORT) has
+ * been stored, the reader consumes events from @tail and stores the new
+ * @tail back.  Both are indices into @events and wrap at @size.
+ */
+struct input_event_ring {
+	__u32 head;
+	__u32 tail;
+	__u32 size;
+	__u32 reserved[5];
+	struct input_event events[0];
+};
+
 /*
  * Protocol version.
  */
@@ -82,6 +97,8 @@ struct input_absinfo {
 
 #define EVIOCGRAB		_IOW('E', 0x90, int)			/* Grab/Release device */
 
+#define EVIOCGRINGSIZE		_IOR('E', 0xa8, int)			/* get length of the mmap()able event ring */
+
 /*
  * Event types
  */
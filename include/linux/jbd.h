@@ -146,6 +146,31 @@ typedef struct journal_header_s
 	__be32		h_sequence;
 } journal_header_t;
 
+/*
+ * Checksum types.
+ */
+#define JFS_CRC32_CHKSUM	1
+#define JFS_MD5_CHKSUM		2
+#define JFS_SHA1_CHKSUM		3
+
+#define JFS_CRC32_CHKSUM_SIZE	4
+
+#define JFS_CHECKSUM_BYTES	(32 / sizeof(u32))
+/*
+ * Commit block header for storing transactional checksums.  The layout
+ * is shared with jbd2, so e2fsck and ext4 can replay such a journal.
+ */
+struct commit_header {
+	__be32		h_magic;
+	__be32		h_blocktype;
+	__be32		h_sequence;
+	unsigned char	h_chksum_type;
+	unsigned char	h_chksum_size;
+	unsigned char	h_padding[2];
+	__be32		h_chksum[JFS_CHECKSUM_BYTES];
+	__be64		h_commit_sec;
+	__be32		h_commit_nsec;
+};
 
 /*
  * The block tag: used to describe a single buffer in the journal
@@ -232,12 +257,16 @@ typedef struct journal_superblock_s
 	((j)->j_format_version >= 2 &&					\
 	 ((j)->j_superblock->s_feature_incompat & cpu_to_be32((mask))))
 
+#define JFS_FEATURE_COMPAT_CHECKSUM	0x00000001
+
 #define JFS_FEATURE_INCOMPAT_REVOKE	0x00000001
+#define JFS_FEATURE_INCOMPAT_ASYNC_COMMIT	0x00000004
 
 /* Features known to this kernel version: */
-#define JFS_KNOWN_COMPAT_FEATURES	0
+#define JFS_KNOWN_COMPAT_FEATURES	JFS_FEATURE_COMPAT_CHECKSUM
 #define JFS_KNOWN_ROCOMPAT_FEATURES	0
-#define JFS_KNOWN_INCOMPAT_FEATURES	JFS_FEATURE_INCOMPAT_REVOKE
+#define JFS_KNOWN_INCOMPAT_FEATURES	(JFS_FEATURE_INCOMPAT_REVOKE | \
+					 JFS_FEATURE_INCOMPAT_ASYNC_COMMIT)
 
 #ifdef __KERNEL__
 
@@ -604,6 +633,8 @@ struct transaction_s
  *  transaction
  * @j_commit_request: Sequence number of the most recent transaction wanting
  *     commit
+ * @j_failed_commit: Sequence number of a transaction whose commit block
+ *     failed its checksum during recovery
  * @j_uuid: Uuid of client object.
  * @j_task: Pointer to the current commit thread for this journal
  * @j_max_transaction_buffers:  Maximum number of metadata buffers to allow in a
@@ -816,6 +847,12 @@ struct journal_s
 	 */
 	pid_t			j_last_sync_writer;
 
+	/*
+	 * Transaction whose commit block was found corrupt by recovery, the
+	 * journal cannot be loaded past it.
+	 */
+	tid_t			j_failed_commit;
+
 	/*
 	 * the average amount of time in nanoseconds it takes to commit a
 	 * transaction to the disk.  [j_state_lock]
@@ -827,6 +864,13 @@ struct journal_s
 	 * superblock pointer here
 	 */
 	void *j_private;
+
+	/*
+	 * Called once the commit record of a transaction is on disk, before
+	 * the buffers it freed are released for reuse.
+	 */
+	void			(*j_commit_callback)(journal_t *,
+						     transaction_t *);
 };
 
 /*
@@ -931,6 +975,8 @@ extern int	   journal_check_available_features
 		   (journal_t *, unsigned long, unsigned long, unsigned long);
 extern int	   journal_set_features
 		   (journal_t *, unsigned long, unsigned long, unsigned long);
+extern void	   journal_clear_features
+		   (journal_t *, unsigned long, unsigned long, unsigned long);
 extern int	   journal_create     (journal_t *);
 extern int	   journal_load       (journal_t *journal);
 extern int	   journal_destroy    (journal_t *);
@@ -1000,6 +1046,8 @@ int __log_start_commit(journal_t *journal, tid_t tid);
 int journal_start_commit(journal_t *journal, tid_t *tid);
 int journal_force_commit_nested(journal_t *journal);
 int log_wait_commit(journal_t *journal, tid_t tid);
+void journal_batch_sync(journal_t *journal, ktime_t start_time);
+void log_batch_commit(journal_t *journal, tid_t tid);
 int log_do_checkpoint(journal_t *journal);
 
 void __log_wait_for_space(journal_t *journal);
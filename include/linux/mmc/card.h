@@ -45,6 +45,11 @@ struct mmc_csd {
 struct mmc_ext_csd {
 	u8			rev;
 	u8			rel_wr_sec_c;
+	u8			rel_param;
+	u8			max_packed_writes;
+	u8			max_packed_reads;
+	u8			packed_event_en;
+	u8			sec_feature_support;
 	u8			power_class[4];
 #define MMC_EXT_CSD_PWR_CL(b)	(b - EXT_CSD_PWR_CL_52_195)
 	unsigned int		sa_timeout;		/* Units: 100ns */
@@ -91,6 +91,30 @@
  *	[02:00] Command Set
  */
 
+/*
+ * MMC_SET_BLOCK_COUNT argument format:
+ *
+ *	[31]    Reliable Write Request
+ *	[30]    Packed command
+ *	[15:00] Number of blocks
+ */
+
+#define MMC_CMD23_ARG_REL_WR	(1 << 31)
+#define MMC_CMD23_ARG_PACKED	(1 << 30)
+
+/*
+ * Packed command header, first word:
+ *
+ *	[23:16] Number of packed entries
+ *	[15:08] Read / write
+ *	[07:00] Version
+ *
+ * followed by a CMD23 and a CMD18/CMD25 argument for every entry.
+ */
+
+#define MMC_PACKED_CMD_VER	0x01
+#define MMC_PACKED_CMD_WR	0x02
+
 /*
   MMC status in R1, for native mode (SPI bits are different)
   Type
@@ -128,6 +152,7 @@
 #define R1_STATUS(x)            (x & 0xFFFFE000)
 #define R1_CURRENT_STATE(x)	((x & 0x00001E00) >> 9)	/* sx, b (4 bits) */
 #define R1_READY_FOR_DATA	(1 << 8)	/* sx, a */
+#define R1_EXCEPTION_EVENT	(1 << 6)	/* sr, a */
 #define R1_SWITCH_ERROR		(1 << 7)	/* sx, c */
 #define R1_APP_CMD		(1 << 5)	/* sr, c */
 
@@ -252,6 +277,11 @@ struct _mmc_csd {
  * EXT_CSD fields
  */
 
+#define EXT_CSD_PACKED_FAILURE_INDEX	35	/* RO */
+#define EXT_CSD_PACKED_CMD_STATUS	36	/* RO */
+#define EXT_CSD_EXP_EVENTS_STATUS	54	/* RO, 2 bytes */
+#define EXT_CSD_EXP_EVENTS_CTRL	56	/* R/W, 2 bytes */
+#define EXT_CSD_WR_REL_PARAM	166	/* RO */
 #define EXT_CSD_BUS_WIDTH	183	/* R/W */
 #define EXT_CSD_HS_TIMING	185	/* R/W */
 #define EXT_CSD_POWER_CLASS	187	/* R/W */
@@ -266,6 +296,9 @@ struct _mmc_csd {
 #define EXT_CSD_S_A_TIMEOUT	217
 #define EXT_CSD_REL_WR_SEC_C    222	/* RO */
 #define EXT_CSD_BOOT_SIZE_MULTI 226
+#define EXT_CSD_SEC_FEATURE_SUPPORT	231	/* RO */
+#define EXT_CSD_MAX_PACKED_WRITES	500	/* RO */
+#define EXT_CSD_MAX_PACKED_READS	501	/* RO */
 /*
  * EXT_CSD field definitions
  */
@@ -282,6 +315,16 @@ struct _mmc_csd {
 #define EXT_CSD_BUS_WIDTH_4	1	/* Card is in 4 bit mode */
 #define EXT_CSD_BUS_WIDTH_8	2	/* Card is in 8 bit mode */
 
+#define EXT_CSD_WR_REL_PARAM_EN		(1<<2)	/* Enhanced reliable write */
+
+#define EXT_CSD_PACKED_EVENT_EN		(1<<3)	/* EXP_EVENTS_CTRL */
+#define EXT_CSD_PACKED_FAILURE		(1<<3)	/* EXP_EVENTS_STATUS */
+
+#define EXT_CSD_SEC_GB_CL_EN		(1<<4)	/* TRIM supported */
+
+#define EXT_CSD_PACKED_GENERIC_ERROR	(1<<0)	/* PACKED_CMD_STATUS */
+#define EXT_CSD_PACKED_INDEXED_ERROR	(1<<1)
+
 /*
  * MMC_SWITCH access modes
  */
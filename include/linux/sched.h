@@ -1449,6 +1449,11 @@ struct task_struct {
 /* stacked block device info */
 	struct bio *bio_list, **bio_tail;
 
+#ifdef CONFIG_BLOCK
+/* stack plugging */
+	struct blk_plug *plug;
+#endif
+
 /* VM state */
 	struct reclaim_state *reclaim_state;
 
@@ -75,4 +75,12 @@ print_tuple(struct seq_file *s, const struct nf_conntrack_tuple *tuple,
 
 extern spinlock_t nf_conntrack_lock ;
 
+/* Hash chains are protected by nf_conntrack_locks[hash % CONNTRACK_LOCKS],
+ * taken with nf_conntrack_bucket_lock() so that a resize can shut them all
+ * out; nf_conntrack_lock is still taken for expectations, helpers and
+ * resize, and nests outside the bucket locks. */
+#define CONNTRACK_LOCKS 256
+extern spinlock_t nf_conntrack_locks[CONNTRACK_LOCKS];
+extern void nf_conntrack_bucket_lock(spinlock_t *lock);
+
 #endif /* _NF_CONNTRACK_CORE_H */
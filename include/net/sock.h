@@ -170,6 +170,7 @@ struct sock_common {
   *	@sk_route_caps: route capabilities (e.g. %NETIF_F_TSO)
   *	@sk_gso_type: GSO type (e.g. %SKB_GSO_TCPV4)
   *	@sk_gso_max_size: Maximum GSO segment size to build
+  *	@sk_pacing_rate: Pacing rate (if supported by transport/packet scheduler)
   *	@sk_lingertime: %SO_LINGER l_linger setting
   *	@sk_backlog: always used with the per-socket spinlock held
   *	@sk_callback_lock: used with the callbacks in the end of this struct
@@ -200,6 +201,9 @@ struct sock_common {
   *	@sk_send_head: front of stuff to transmit
   *	@sk_security: used by security modules
   *	@sk_mark: generic packet mark
+  *	@sk_tag_uid: uid the socket's traffic is accounted to
+  *	@sk_tag: traffic accounting tag
+  *	@sk_tag_stat: accounting entry used for the last packet
   *	@sk_write_pending: a write to stream socket waits to start
   *	@sk_state_change: callback to indicate change in the state of the sock
   *	@sk_data_ready: callback to indicate there is data to be processed
@@ -267,6 +271,7 @@ struct sock {
 	int			sk_route_caps;
 	int			sk_gso_type;
 	unsigned int		sk_gso_max_size;
+	u32			sk_pacing_rate; /* bytes per second */
 	int			sk_rcvlowat;
 	unsigned long 		sk_flags;
 	unsigned long	        sk_lingertime;
@@ -297,6 +302,11 @@ struct sock {
 #endif
 	__u32			sk_mark;
 	/* XXX 4 bytes hole on 64 bit */
+#ifdef CONFIG_INET_TAG_STAT
+	uid_t			sk_tag_uid;
+	__u32			sk_tag;
+	void			*sk_tag_stat;
+#endif
 	void			(*sk_state_change)(struct sock *sk);
 	void			(*sk_data_ready)(struct sock *sk, int bytes);
 	void			(*sk_write_space)(struct sock *sk);
@@ -660,6 +670,8 @@ struct proto {
 	int			(*backlog_rcv) (struct sock *sk, 
 						struct sk_buff *skb);
 
+	void		(*release_cb)(struct sock *sk);
+
 	/* Keeping track of sk's, looking them up, and port selection methods. */
 	void			(*hash)(struct sock *sk);
 	void			(*unhash)(struct sock *sk);
@@ -0,0 +1,41 @@
+#ifndef _NET_TAG_STAT_H
+#define _NET_TAG_STAT_H
+
+/*
+ * Per-UID socket tagged traffic accounting.
+ *
+ * Every socket carries the uid it is accounted to and an optional tag
+ * set from user space through /proc/net/tag_stat/ctrl.  The IPv4 output
+ * path and the TCP/UDP receive paths charge each packet to the
+ * (uid, tag, iface) counters, which are read from /proc/net/tag_stat/stats.
+ */
+
+#include <linux/netdevice.h>
+#include <net/sock.h>
+
+enum {
+	TAG_STAT_RX,
+	TAG_STAT_TX,
+	TAG_STAT_DIRS,
+};
+
+#ifdef CONFIG_INET_TAG_STAT
+extern void __tag_stat_account(struct sock *sk, const struct net_device *dev,
+			       unsigned int len, int dir);
+
+static inline void tag_stat_account(struct sock *sk,
+				    const struct net_device *dev,
+				    unsigned int len, int dir)
+{
+	if (sk && dev)
+		__tag_stat_account(sk, dev, len, dir);
+}
+#else
+static inline void tag_stat_account(struct sock *sk,
+				    const struct net_device *dev,
+				    unsigned int len, int dir)
+{
+}
+#endif
+
+#endif	/* _NET_TAG_STAT_H */
@@ -8,6 +8,9 @@
 #include <linux/dirent.h>
 #include <linux/syscalls.h>
 #include <linux/utime.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
 
 static __initdata char *message;
 static void __init error(char *x)
@@ -384,6 +387,8 @@ static int __init write_buffer(char *buf, unsigned len)
 	return len - count;
 }
 
+static unsigned long my_outbytes __initdata;	/* decompressed bytes */
+
 static int __init flush_buffer(void *bufv, unsigned len)
 {
 	char *buf = (char *) bufv;
@@ -391,6 +396,7 @@ static int __init flush_buffer(void *bufv, unsigned len)
 	int origLen = len;
 	if (message)
 		return -1;
+	my_outbytes += len;
 	while ((written = write_buffer(buf, len)) < len && !message) {
 		char c = buf[written];
 		if (c == '0') {
@@ -417,6 +423,8 @@ static char * __init unpack_to_rootfs(char *buf, unsigned len)
 	decompress_fn decompress;
 	const char *compress_name;
 	static __initdata char msg_buf[64];
+	ktime_t start;
+	unsigned long usecs;
 
 	header_buf = kmalloc(110, GFP_KERNEL);
 	symlink_buf = kmalloc(PATH_MAX + N_ALIGN(PATH_MAX) + 1, GFP_KERNEL);
@@ -445,10 +453,18 @@ static char * __init unpack_to_rootfs(char *buf, unsigned len)
 		}
 		this_header = 0;
 		decompress = decompress_method(buf, len, &compress_name);
-		if (decompress)
+		if (decompress) {
+			my_outbytes = 0;
+			start = ktime_get();
 			decompress(buf, len, NULL, flush_buffer, NULL,
 				   &my_inptr, error);
-		else if (compress_name) {
+			usecs = ktime_us_delta(ktime_get(), start) ? : 1;
+			printk(KERN_INFO "initramfs: unpacked %s, %u kB to "
+			       "%lu kB in %lu.%03lu ms (%llu kB/s)\n",
+			       compress_name, my_inptr >> 10,
+			       my_outbytes >> 10, usecs / 1000, usecs % 1000,
+			       div_u64((u64)my_outbytes * 1000, usecs));
+		} else if (compress_name) {
 			if (!message) {
 				snprintf(msg_buf, sizeof msg_buf,
 					 "compression method %s not configured",
@@ -0,0 +1,593 @@
+/*
+ * padata.c - generic interface to process data streams in parallel
+ *
+ * Objects are spread round robin over the cpus of the instance by their
+ * sequence number and processed there by the user's parallel callback.
+ * Once done, padata_do_serial() parks them on the reorder list of that
+ * cpu, from which they are pulled strictly in sequence order and handed
+ * to the serial callback on the cpu the user asked for.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/cpumask.h>
+#include <linux/err.h>
+#include <linux/cpu.h>
+#include <linux/padata.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/delay.h>
+#include <linux/rcupdate.h>
+
+/* Bound the number of objects in flight so a stalled cpu can't eat memory */
+#define MAX_OBJ_NUM		(1000 * NR_CPUS)
+
+static int padata_index_to_cpu(struct parallel_data *pd, int cpu_index)
+{
+	int cpu, target_cpu;
+
+	target_cpu = cpumask_first(pd->cpumask);
+	for (cpu = 0; cpu < cpu_index; cpu++)
+		target_cpu = cpumask_next(target_cpu, pd->cpumask);
+
+	return target_cpu;
+}
+
+static int padata_seq_to_cpu(struct parallel_data *pd, unsigned int seq_nr)
+{
+	return padata_index_to_cpu(pd, seq_nr % cpumask_weight(pd->cpumask));
+}
+
+static void padata_parallel_worker(struct work_struct *work)
+{
+	struct padata_queue *queue;
+	LIST_HEAD(local_list);
+
+	local_bh_disable();
+	queue = container_of(work, struct padata_queue, pwork);
+
+	spin_lock(&queue->parallel.lock);
+	list_replace_init(&queue->parallel.list, &local_list);
+	spin_unlock(&queue->parallel.lock);
+
+	while (!list_empty(&local_list)) {
+		struct padata_priv *padata;
+
+		padata = list_entry(local_list.next,
+				    struct padata_priv, list);
+
+		list_del_init(&padata->list);
+
+		padata->parallel(padata);
+	}
+
+	local_bh_enable();
+}
+
+/**
+ * padata_do_parallel - padata parallelization function
+ *
+ * @pinst: padata instance
+ * @padata: object to be parallelized
+ * @cb_cpu: cpu the serialization callback function will run on,
+ *          must be in the cpumask of padata.
+ *
+ * The parallelization callback function will run with BHs off.
+ * Note: Every object which is parallelized by padata_do_parallel
+ * must be seen by padata_do_serial.
+ *
+ * Returns 0 if the object was queued, -EINVAL if the instance is not
+ * started or @cb_cpu is not usable and -EAGAIN if the instance is being
+ * reconfigured or has too many objects in flight.  -EBUSY is avoided on
+ * purpose: crypto users take it to mean the request was backlogged.
+ */
+int padata_do_parallel(struct padata_instance *pinst,
+		       struct padata_priv *padata, int cb_cpu)
+{
+	int target_cpu, err;
+	struct padata_queue *queue;
+	struct parallel_data *pd;
+
+	rcu_read_lock_bh();
+
+	pd = rcu_dereference(pinst->pd);
+
+	err = -EINVAL;
+	if (!(pinst->flags & PADATA_INIT))
+		goto out;
+
+	err = -EAGAIN;
+	if ((pinst->flags & PADATA_RESET))
+		goto out;
+
+	if (atomic_read(&pd->refcnt) >= MAX_OBJ_NUM)
+		goto out;
+
+	err = -EINVAL;
+	if (!cpumask_test_cpu(cb_cpu, pd->cpumask))
+		goto out;
+
+	err = 0;
+	atomic_inc(&pd->refcnt);
+	padata->pd = pd;
+	padata->cb_cpu = cb_cpu;
+	padata->seq_nr = atomic_inc_return(&pd->seq_nr) - 1;
+
+	target_cpu = padata_seq_to_cpu(pd, padata->seq_nr);
+	queue = per_cpu_ptr(pd->queue, target_cpu);
+
+	spin_lock(&queue->parallel.lock);
+	list_add_tail(&padata->list, &queue->parallel.list);
+	spin_unlock(&queue->parallel.lock);
+
+	queue_work_on(target_cpu, pinst->wq, &queue->pwork);
+
+out:
+	rcu_read_unlock_bh();
+
+	return err;
+}
+EXPORT_SYMBOL(padata_do_parallel);
+
+/*
+ * Take the object with the next sequence number off its reorder list,
+ * or return NULL if it has not been through padata_do_serial() yet.
+ * Called with pd->lock held.
+ */
+static struct padata_priv *padata_get_next(struct parallel_data *pd)
+{
+	struct padata_list *reorder;
+	struct padata_priv *padata = NULL;
+	int cpu;
+
+	cpu = padata_seq_to_cpu(pd, pd->processed);
+	reorder = &per_cpu_ptr(pd->queue, cpu)->reorder;
+
+	spin_lock(&reorder->lock);
+	if (!list_empty(&reorder->list)) {
+		padata = list_entry(reorder->list.next,
+				    struct padata_priv, list);
+
+		if (padata->seq_nr == pd->processed) {
+			list_del_init(&padata->list);
+			pd->processed++;
+		} else
+			padata = NULL;
+	}
+	spin_unlock(&reorder->lock);
+
+	return padata;
+}
+
+static void padata_reorder(struct parallel_data *pd)
+{
+	struct padata_priv *padata;
+	struct padata_queue *queue;
+
+	/*
+	 * Every caller adds to a reorder list before getting here, so
+	 * whoever holds the lock last sees all objects that are ready.
+	 */
+	spin_lock(&pd->lock);
+
+	while ((padata = padata_get_next(pd))) {
+		queue = per_cpu_ptr(pd->queue, padata->cb_cpu);
+
+		spin_lock(&queue->serial.lock);
+		list_add_tail(&padata->list, &queue->serial.list);
+		spin_unlock(&queue->serial.lock);
+
+		queue_work_on(padata->cb_cpu, pd->pinst->wq, &queue->swork);
+	}
+
+	spin_unlock(&pd->lock);
+}
+
+static void padata_serial_worker(struct work_struct *work)
+{
+	struct padata_queue *queue;
+	struct parallel_data *pd;
+	LIST_HEAD(local_list);
+
+	local_bh_disable();
+	queue = container_of(work, struct padata_queue, swork);
+	pd = queue->pd;
+
+	spin_lock(&queue->serial.lock);
+	list_replace_init(&queue->serial.list, &local_list);
+	spin_unlock(&queue->serial.lock);
+
+	while (!list_empty(&local_list)) {
+		struct padata_priv *padata;
+
+		padata = list_entry(local_list.next,
+				    struct padata_priv, list);
+
+		list_del_init(&padata->list);
+
+		padata->serial(padata);
+		atomic_dec(&pd->refcnt);
+	}
+	local_bh_enable();
+}
+
+/**
+ * padata_do_serial - padata serialization function
+ *
+ * @padata: object to be serialized.
+ *
+ * padata_do_serial must be called for every parallelized object.
+ * The serialization callback function will run with BHs off, and so
+ * must the caller of this function.
+ */
+void padata_do_serial(struct padata_priv *padata)
+{
+	struct parallel_data *pd = padata->pd;
+	struct padata_list *reorder;
+	struct padata_priv *cur;
+	int cpu;
+
+	cpu = padata_seq_to_cpu(pd, padata->seq_nr);
+	reorder = &per_cpu_ptr(pd->queue, cpu)->reorder;
+
+	/*
+	 * Objects of one cpu normally finish in order, but an asynchronous
+	 * parallel callback may complete them in any order: keep the list
+	 * sorted, looking from the tail where the object usually belongs.
+	 */
+	spin_lock(&reorder->lock);
+	list_for_each_entry_reverse(cur, &reorder->list, list)
+		if ((int)(cur->seq_nr - padata->seq_nr) < 0)
+			break;
+	list_add(&padata->list, &cur->list);
+	spin_unlock(&reorder->lock);
+
+	padata_reorder(pd);
+}
+EXPORT_SYMBOL(padata_do_serial);
+
+/* Allocate and initialize the internal cpumask dependent resources. */
+static struct parallel_data *padata_alloc_pd(struct padata_instance *pinst,
+					     const struct cpumask *cpumask)
+{
+	int cpu;
+	struct padata_queue *queue;
+	struct parallel_data *pd;
+
+	pd = kzalloc(sizeof(struct parallel_data), GFP_KERNEL);
+	if (!pd)
+		goto err;
+
+	pd->queue = alloc_percpu(struct padata_queue);
+	if (!pd->queue)
+		goto err_free_pd;
+
+	if (!alloc_cpumask_var(&pd->cpumask, GFP_KERNEL))
+		goto err_free_queue;
+
+	cpumask_and(pd->cpumask, cpumask, cpu_active_mask);
+
+	for_each_possible_cpu(cpu) {
+		queue = per_cpu_ptr(pd->queue, cpu);
+
+		queue->pd = pd;
+
+		INIT_LIST_HEAD(&queue->parallel.list);
+		INIT_LIST_HEAD(&queue->reorder.list);
+		INIT_LIST_HEAD(&queue->serial.list);
+		spin_lock_init(&queue->parallel.lock);
+		spin_lock_init(&queue->reorder.lock);
+		spin_lock_init(&queue->serial.lock);
+
+		INIT_WORK(&queue->pwork, padata_parallel_worker);
+		INIT_WORK(&queue->swork, padata_serial_worker);
+	}
+
+	atomic_set(&pd->seq_nr, 0);
+	atomic_set(&pd->refcnt, 0);
+	pd->pinst = pinst;
+	spin_lock_init(&pd->lock);
+
+	return pd;
+
+err_free_queue:
+	free_percpu(pd->queue);
+err_free_pd:
+	kfree(pd);
+err:
+	return NULL;
+}
+
+static void padata_free_pd(struct parallel_data *pd)
+{
+	free_cpumask_var(pd->cpumask);
+	free_percpu(pd->queue);
+	kfree(pd);
+}
+
+/*
+ * Wait until every object of @pd went through its serial callback.  An
+ * asynchronous parallel callback may still hold some after the work
+ * items ran, so keep flushing until the last reference is gone.
+ */
+static void padata_flush_queues(struct parallel_data *pd)
+{
+	for (;;) {
+		flush_workqueue(pd->pinst->wq);
+		if (!atomic_read(&pd->refcnt))
+			break;
+		msleep(1);
+	}
+}
+
+/*
+ * Switch to a new parallel_data.  New objects are refused with -EAGAIN
+ * until the old one is drained, so that ordering is kept across the
+ * switch.  Called with pinst->lock held.
+ */
+static void padata_replace(struct padata_instance *pinst,
+			   struct parallel_data *pd_new)
+{
+	struct parallel_data *pd_old = pinst->pd;
+
+	pinst->flags |= PADATA_RESET;
+
+	synchronize_rcu_bh();
+	padata_flush_queues(pd_old);
+
+	rcu_assign_pointer(pinst->pd, pd_new);
+	pinst->flags &= ~PADATA_RESET;
+
+	synchronize_rcu_bh();
+	padata_free_pd(pd_old);
+}
+
+/*
+ * Lock order is get_online_cpus() before pinst->lock, as the hotplug
+ * notifier takes pinst->lock with the hotplug lock held.
+ */
+static int __padata_set_cpus(struct padata_instance *pinst,
+			     const struct cpumask *cpumask)
+{
+	struct parallel_data *pd;
+
+	pd = padata_alloc_pd(pinst, cpumask);
+	if (!pd)
+		return -ENOMEM;
+
+	padata_replace(pinst, pd);
+
+	return 0;
+}
+
+/**
+ * padata_set_cpumask - set the cpumask that padata should use
+ *
+ * @pinst: padata instance
+ * @cpumask: the cpumask to use
+ */
+int padata_set_cpumask(struct padata_instance *pinst,
+			cpumask_var_t cpumask)
+{
+	int err;
+
+	if (!cpumask_intersects(cpumask, cpu_possible_mask))
+		return -EINVAL;
+
+	get_online_cpus();
+	mutex_lock(&pinst->lock);
+
+	err = __padata_set_cpus(pinst, cpumask);
+	if (!err)
+		cpumask_copy(pinst->cpumask, cpumask);
+
+	mutex_unlock(&pinst->lock);
+	put_online_cpus();
+
+	return err;
+}
+EXPORT_SYMBOL(padata_set_cpumask);
+
+static int __padata_add_cpu(struct padata_instance *pinst, int cpu)
+{
+	int err;
+
+	cpumask_set_cpu(cpu, pinst->cpumask);
+	err = __padata_set_cpus(pinst, pinst->cpumask);
+	if (err)
+		cpumask_clear_cpu(cpu, pinst->cpumask);
+
+	return err;
+}
+
+/**
+ * padata_add_cpu - add a cpu to the padata cpumask
+ *
+ * @pinst: padata instance
+ * @cpu: cpu to add
+ */
+int padata_add_cpu(struct padata_instance *pinst, int cpu)
+{
+	int err;
+
+	get_online_cpus();
+	mutex_lock(&pinst->lock);
+
+	err = __padata_add_cpu(pinst, cpu);
+
+	mutex_unlock(&pinst->lock);
+	put_online_cpus();
+
+	return err;
+}
+EXPORT_SYMBOL(padata_add_cpu);
+
+static int __padata_remove_cpu(struct padata_instance *pinst, int cpu)
+{
+	int err;
+
+	cpumask_clear_cpu(cpu, pinst->cpumask);
+	err = __padata_set_cpus(pinst, pinst->cpumask);
+	if (err)
+		cpumask_set_cpu(cpu, pinst->cpumask);
+
+	return err;
+}
+
+/**
+ * padata_remove_cpu - remove a cpu from the padata cpumask
+ *
+ * @pinst: padata instance
+ * @cpu: cpu to remove
+ */
+int padata_remove_cpu(struct padata_instance *pinst, int cpu)
+{
+	int err;
+
+	get_online_cpus();
+	mutex_lock(&pinst->lock);
+
+	err = __padata_remove_cpu(pinst, cpu);
+
+	mutex_unlock(&pinst->lock);
+	put_online_cpus();
+
+	return err;
+}
+EXPORT_SYMBOL(padata_remove_cpu);
+
+/**
+ * padata_start - start the parallel processing
+ *
+ * @pinst: padata instance to start
+ */
+void padata_start(struct padata_instance *pinst)
+{
+	mutex_lock(&pinst->lock);
+	pinst->flags |= PADATA_INIT;
+	mutex_unlock(&pinst->lock);
+}
+EXPORT_SYMBOL(padata_start);
+
+/**
+ * padata_stop - stop the parallel processing
+ *
+ * @pinst: padata instance to stop
+ */
+void padata_stop(struct padata_instance *pinst)
+{
+	mutex_lock(&pinst->lock);
+	pinst->flags &= ~PADATA_INIT;
+	mutex_unlock(&pinst->lock);
+}
+EXPORT_SYMBOL(padata_stop);
+
+/*
+ * The cpu going down is already out of cpu_active_mask and the one
+ * coming up already in it, so rebuilding the parallel_data from the
+ * user cpumask is all that is needed.  Nothing to do before
+ * padata_alloc() installed the first one, it will see the new mask.
+ */
+static int __cpuinit padata_cpu_callback(struct notifier_block *nfb,
+					 unsigned long action, void *hcpu)
+{
+	int err;
+	struct padata_instance *pinst;
+	int cpu = (unsigned long)hcpu;
+
+	pinst = container_of(nfb, struct padata_instance, cpu_notifier);
+
+	switch (action) {
+	case CPU_ONLINE:
+	case CPU_ONLINE_FROZEN:
+	case CPU_DOWN_PREPARE:
+	case CPU_DOWN_PREPARE_FROZEN:
+	case CPU_DOWN_FAILED:
+	case CPU_DOWN_FAILED_FROZEN:
+		if (!cpumask_test_cpu(cpu, pinst->cpumask))
+			break;
+		mutex_lock(&pinst->lock);
+		err = pinst->pd ? __padata_set_cpus(pinst, pinst->cpumask) : 0;
+		mutex_unlock(&pinst->lock);
+		if (err)
+			return NOTIFY_BAD;
+		break;
+	}
+
+	return NOTIFY_OK;
+}
+
+/**
+ * padata_alloc - allocate and initialize a padata instance
+ *
+ * @cpumask: cpumask that padata uses for parallelization
+ * @wq: workqueue to use for the allocated padata instance
+ */
+struct padata_instance *padata_alloc(const struct cpumask *cpumask,
+				     struct workqueue_struct *wq)
+{
+	struct padata_instance *pinst;
+	struct parallel_data *pd;
+
+	pinst = kzalloc(sizeof(struct padata_instance), GFP_KERNEL);
+	if (!pinst)
+		goto err;
+
+	if (!alloc_cpumask_var(&pinst->cpumask, GFP_KERNEL))
+		goto err_free_inst;
+
+	cpumask_copy(pinst->cpumask, cpumask);
+	pinst->wq = wq;
+	pinst->flags = 0;
+	mutex_init(&pinst->lock);
+
+	pinst->cpu_notifier.notifier_call = padata_cpu_callback;
+	pinst->cpu_notifier.priority = 0;
+	register_hotcpu_notifier(&pinst->cpu_notifier);
+
+	get_online_cpus();
+	mutex_lock(&pinst->lock);
+
+	pd = padata_alloc_pd(pinst, cpumask);
+	if (pd)
+		rcu_assign_pointer(pinst->pd, pd);
+
+	mutex_unlock(&pinst->lock);
+	put_online_cpus();
+
+	if (!pd)
+		goto err_unregister;
+
+	return pinst;
+
+err_unregister:
+	unregister_hotcpu_notifier(&pinst->cpu_notifier);
+	free_cpumask_var(pinst->cpumask);
+err_free_inst:
+	kfree(pinst);
+err:
+	return NULL;
+}
+EXPORT_SYMBOL(padata_alloc);
+
+/**
+ * padata_free - free a padata instance
+ *
+ * @pinst: padata instance to free
+ */
+void padata_free(struct padata_instance *pinst)
+{
+	padata_stop(pinst);
+
+	synchronize_rcu_bh();
+
+	unregister_hotcpu_notifier(&pinst->cpu_notifier);
+	padata_flush_queues(pinst->pd);
+	padata_free_pd(pinst->pd);
+	free_cpumask_var(pinst->cpumask);
+	kfree(pinst);
+}
+EXPORT_SYMBOL(padata_free);
@@ -66,6 +66,7 @@
 #include <linux/delayacct.h>
 #include <linux/unistd.h>
 #include <linux/pagemap.h>
+#include <linux/blkdev.h>
 #include <linux/hrtimer.h>
 #include <linux/tick.h>
 #include <linux/debugfs.h>
@@ -5421,6 +5422,20 @@ pick_next_task(struct rq *rq)
 	}
 }
 
+/*
+ * A task about to sleep may be waiting for I/O it still holds on its
+ * plug list, so send that off first.  Not when being preempted: the
+ * task will be back without waiting for anything.
+ */
+static inline void sched_submit_work(struct task_struct *tsk)
+{
+	if (!tsk->state || (preempt_count() & PREEMPT_ACTIVE))
+		return;
+
+	if (blk_needs_flush_plug(tsk))
+		blk_flush_plug(tsk);
+}
+
 /*
  * schedule() is the main scheduler function.
  */
@@ -5431,6 +5446,8 @@ asmlinkage void __sched schedule(void)
 	struct rq *rq;
 	int cpu;
 
+	sched_submit_work(current);
+
 need_resched:
 	preempt_disable();
 	cpu = smp_processor_id();
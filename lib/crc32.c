@@ -27,13 +27,19 @@
 #include <linux/types.h>
 #include <linux/slab.h>
 #include <linux/init.h>
+#include <linux/jiffies.h>
+#include <linux/gfp.h>
 #include <asm/atomic.h>
 #include "crc32defs.h"
 #if CRC_LE_BITS == 8
 #define tole(x) __constant_cpu_to_le32(x)
-#define tobe(x) __constant_cpu_to_be32(x)
 #else
 #define tole(x) (x)
+#endif
+
+#if CRC_BE_BITS == 8
+#define tobe(x) __constant_cpu_to_be32(x)
+#else
 #define tobe(x) (x)
 #endif
 #include "crc32table.h"
@@ -42,99 +48,209 @@ MODULE_AUTHOR("Matt Domsch <Matt_Domsch@dell.com>");
 MODULE_DESCRIPTION("Ethernet CRC32 calculations");
 MODULE_LICENSE("GPL");
 
-/**
- * crc32_le() - Calculate bitwise little-endian Ethernet AUTODIN II CRC32
- * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
- *	other uses, or the previous crc32 value if computing incrementally.
- * @p: pointer to buffer over which CRC is run
- * @len: length of buffer @p
- */
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len);
+#if CRC_LE_BITS == 8 || CRC_BE_BITS == 8
 
-#if CRC_LE_BITS == 1
 /*
- * In fact, the table-based code will work in this case, but it can be
- * simplified by inlining the table in ?: form.
+ * The table-driven loops are shared by all three CRCs.  The crc is kept
+ * in memory byte order (cpu_to_le32 for the reflected CRCs, cpu_to_be32
+ * for crc32_be) and the tables are stored the same way, so a word loaded
+ * from the buffer can be xored into it directly.
  */
+#ifdef __LITTLE_ENDIAN
+# define DO_CRC(x) crc = t0[(crc ^ (x)) & 255] ^ (crc >> 8)
+# define DO_CRC4 (t3[(q) & 255] ^ t2[(q >> 8) & 255] ^ \
+		  t1[(q >> 16) & 255] ^ t0[(q >> 24) & 255])
+# define DO_CRC8 (t7[(q) & 255] ^ t6[(q >> 8) & 255] ^ \
+		  t5[(q >> 16) & 255] ^ t4[(q >> 24) & 255])
+#else
+# define DO_CRC(x) crc = t0[((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
+# define DO_CRC4 (t0[(q) & 255] ^ t1[(q >> 8) & 255] ^ \
+		  t2[(q >> 16) & 255] ^ t3[(q >> 24) & 255])
+# define DO_CRC8 (t4[(q) & 255] ^ t5[(q >> 8) & 255] ^ \
+		  t6[(q >> 16) & 255] ^ t7[(q >> 24) & 255])
+#endif
 
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+/* One table lookup per byte */
+static u32 __pure crc32_body_sarwate(u32 crc, unsigned char const *buf,
+				     size_t len, const u32 (*tab)[256])
 {
-	int i;
-	while (len--) {
-		crc ^= *p++;
-		for (i = 0; i < 8; i++)
-			crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY_LE : 0);
-	}
+	const u32 *t0 = tab[0];
+
+	while (len--)
+		DO_CRC(*buf++);
 	return crc;
 }
-#else				/* Table-based approach */
 
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+/* Four lookups per 32-bit word, in independent tables */
+static u32 __pure crc32_body_slice4(u32 crc, unsigned char const *buf,
+				    size_t len, const u32 (*tab)[256])
 {
-# if CRC_LE_BITS == 8
-	const u32      *b =(u32 *)p;
-	const u32      *tab = crc32table_le;
+	const u32 *b;
+	size_t rem_len;
+	const u32 *t0 = tab[0], *t1 = tab[1], *t2 = tab[2], *t3 = tab[3];
+	u32 q;
 
-# ifdef __LITTLE_ENDIAN
-#  define DO_CRC(x) crc = tab[ (crc ^ (x)) & 255 ] ^ (crc>>8)
-# else
-#  define DO_CRC(x) crc = tab[ ((crc >> 24) ^ (x)) & 255] ^ (crc<<8)
-# endif
-
-	crc = __cpu_to_le32(crc);
 	/* Align it */
-	if(unlikely(((long)b)&3 && len)){
+	if (unlikely((long)buf & 3 && len)) {
 		do {
-			u8 *p = (u8 *)b;
-			DO_CRC(*p++);
-			b = (void *)p;
-		} while ((--len) && ((long)b)&3 );
+			DO_CRC(*buf++);
+		} while ((--len) && ((long)buf) & 3);
 	}
-	if(likely(len >= 4)){
-		/* load data 32 bits wide, xor data 32 bits wide. */
-		size_t save_len = len & 3;
-	        len = len >> 2;
-		--b; /* use pre increment below(*++b) for speed */
-		do {
-			crc ^= *++b;
-			DO_CRC(0);
-			DO_CRC(0);
-			DO_CRC(0);
-			DO_CRC(0);
-		} while (--len);
-		b++; /* point to next byte(s) */
-		len = save_len;
+
+	rem_len = len & 3;
+	len = len >> 2;
+	b = (const u32 *)buf;
+	while (len--) {
+		q = crc ^ *b++;
+		crc = DO_CRC4;
 	}
+
 	/* And the last few bytes */
-	if(len){
+	buf = (unsigned char const *)b;
+	while (rem_len--)
+		DO_CRC(*buf++);
+	return crc;
+}
+
+/* Eight lookups per 64 bits of input, two words at a time */
+static u32 __pure crc32_body_slice8(u32 crc, unsigned char const *buf,
+				    size_t len, const u32 (*tab)[256])
+{
+	const u32 *b;
+	size_t rem_len;
+	const u32 *t0 = tab[0], *t1 = tab[1], *t2 = tab[2], *t3 = tab[3];
+	const u32 *t4 = tab[4], *t5 = tab[5], *t6 = tab[6], *t7 = tab[7];
+	u32 q;
+
+	/* Align it */
+	if (unlikely((long)buf & 3 && len)) {
 		do {
-			u8 *p = (u8 *)b;
-			DO_CRC(*p++);
-			b = (void *)p;
-		} while (--len);
+			DO_CRC(*buf++);
+		} while ((--len) && ((long)buf) & 3);
 	}
 
-	return __le32_to_cpu(crc);
-#undef ENDIAN_SHIFT
+	rem_len = len & 7;
+	len = len >> 3;
+	b = (const u32 *)buf;
+	while (len--) {
+		q = crc ^ *b++;
+		crc = DO_CRC8;
+		q = *b++;
+		crc ^= DO_CRC4;
+	}
+
+	/* And the last few bytes */
+	buf = (unsigned char const *)b;
+	while (rem_len--)
+		DO_CRC(*buf++);
+	return crc;
+}
+
 #undef DO_CRC
+#undef DO_CRC4
+#undef DO_CRC8
 
-# elif CRC_LE_BITS == 4
+/**
+ * struct crc32_template - one of the table-driven loops
+ * @name: name printed by the boot-time benchmark
+ * @body: the loop itself
+ * @speed: measured throughput in kB/s, filled in by crc32_calibrate()
+ */
+struct crc32_template {
+	const char *name;
+	u32 (*body)(u32 crc, unsigned char const *buf, size_t len,
+		    const u32 (*tab)[256]);
+	int speed;
+};
+
+static struct crc32_template crc32_templates[] __initdata = {
+	{ .name = "sarwate",	.body = crc32_body_sarwate },
+	{ .name = "slice-by-4",	.body = crc32_body_slice4 },
+	{ .name = "slice-by-8",	.body = crc32_body_slice8 },
+};
+
+/*
+ * The loop picked by crc32_calibrate().  Slice-by-8 is the fastest on
+ * most CPUs, so use it until the benchmark has run.  On cores with small
+ * data caches the 8kB per polynomial can make slice-by-4 win instead.
+ */
+static u32 (*crc32_body)(u32 crc, unsigned char const *buf, size_t len,
+			 const u32 (*tab)[256]) __read_mostly =
+	crc32_body_slice8;
+
+#endif /* CRC_LE_BITS == 8 || CRC_BE_BITS == 8 */
+
+/**
+ * crc32_le() - Calculate bitwise little-endian Ethernet AUTODIN II CRC32
+ * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
+ *	other uses, or the previous crc32 value if computing incrementally.
+ * @p: pointer to buffer over which CRC is run
+ * @len: length of buffer @p
+ */
+static inline u32 __pure crc32_le_generic(u32 crc, unsigned char const *p,
+					  size_t len, const u32 (*tab)[256],
+					  u32 polynomial)
+{
+#if CRC_LE_BITS == 1
+	int i;
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
 	}
-	return crc;
 # elif CRC_LE_BITS == 2
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
 	}
+# elif CRC_LE_BITS == 4
+	while (len--) {
+		crc ^= *p++;
+		crc = (crc >> 4) ^ tab[0][crc & 15];
+		crc = (crc >> 4) ^ tab[0][crc & 15];
+	}
+# elif CRC_LE_BITS == 8
+	crc = __cpu_to_le32(crc);
+	crc = crc32_body(crc, p, len, tab);
+	crc = __le32_to_cpu(crc);
+#endif
 	return crc;
-# endif
+}
+
+#if CRC_LE_BITS == 1
+u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len, NULL, CRCPOLY_LE);
+}
+#else
+u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len,
+			(const u32 (*)[256])crc32table_le, CRCPOLY_LE);
+}
+#endif
+
+/**
+ * __crc32c_le() - Calculate the CRC32c (Castagnoli) of a buffer
+ * @crc: seed value for computation, or the previous crc32c value if
+ *	computing incrementally.  Like crc32_le(), no final inversion
+ *	is done.
+ * @p: pointer to buffer over which CRC is run
+ * @len: length of buffer @p
+ */
+#if CRC_LE_BITS == 1
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len, NULL, CRC32C_POLY_LE);
+}
+#else
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len,
+			(const u32 (*)[256])crc32ctable_le, CRC32C_POLY_LE);
 }
 #endif
 
@@ -145,16 +261,9 @@ u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
  * @p: pointer to buffer over which CRC is run
  * @len: length of buffer @p
  */
-u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len);
-
-#if CRC_BE_BITS == 1
-/*
- * In fact, the table-based code will work in this case, but it can be
- * simplified by inlining the table in ?: form.
- */
-
 u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 {
+#if CRC_BE_BITS == 1
 	int i;
 	while (len--) {
 		crc ^= *p++ << 24;
@@ -163,80 +272,320 @@ u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 			    (crc << 1) ^ ((crc & 0x80000000) ? CRCPOLY_BE :
 					  0);
 	}
+# elif CRC_BE_BITS == 2
+	while (len--) {
+		crc ^= *p++ << 24;
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+	}
+# elif CRC_BE_BITS == 4
+	while (len--) {
+		crc ^= *p++ << 24;
+		crc = (crc << 4) ^ crc32table_be[0][crc >> 28];
+		crc = (crc << 4) ^ crc32table_be[0][crc >> 28];
+	}
+# elif CRC_BE_BITS == 8
+	crc = __cpu_to_be32(crc);
+	crc = crc32_body(crc, p, len, (const u32 (*)[256])crc32table_be);
+	crc = __be32_to_cpu(crc);
+#endif
 	return crc;
 }
 
-#else				/* Table-based approach */
-u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
-{
-# if CRC_BE_BITS == 8
-	const u32      *b =(u32 *)p;
-	const u32      *tab = crc32table_be;
+EXPORT_SYMBOL(crc32_le);
+EXPORT_SYMBOL(__crc32c_le);
+EXPORT_SYMBOL(crc32_be);
 
-# ifdef __LITTLE_ENDIAN
-#  define DO_CRC(x) crc = tab[ (crc ^ (x)) & 255 ] ^ (crc>>8)
-# else
-#  define DO_CRC(x) crc = tab[ ((crc >> 24) ^ (x)) & 255] ^ (crc<<8)
-# endif
+/*
+ * Multiply two polynomials modulo the (reflected) CRC polynomial.
+ * x^31 is bit 0, as in the crc itself.
+ */
+static u32 __attribute_const__ gf2_multiply(u32 x, u32 y, u32 modulus)
+{
+	u32 product = x & 1 ? y : 0;
+	int i;
 
-	crc = __cpu_to_be32(crc);
-	/* Align it */
-	if(unlikely(((long)b)&3 && len)){
-		do {
-			u8 *p = (u8 *)b;
-			DO_CRC(*p++);
-			b = (u32 *)p;
-		} while ((--len) && ((long)b)&3 );
+	for (i = 0; i < 31; i++) {
+		product = (product >> 1) ^ (product & 1 ? modulus : 0);
+		x >>= 1;
+		product ^= x & 1 ? y : 0;
 	}
-	if(likely(len >= 4)){
-		/* load data 32 bits wide, xor data 32 bits wide. */
-		size_t save_len = len & 3;
-	        len = len >> 2;
-		--b; /* use pre increment below(*++b) for speed */
-		do {
-			crc ^= *++b;
-			DO_CRC(0);
-			DO_CRC(0);
-			DO_CRC(0);
-			DO_CRC(0);
-		} while (--len);
-		b++; /* point to next byte(s) */
-		len = save_len;
-	}
-	/* And the last few bytes */
-	if(len){
-		do {
-			u8 *p = (u8 *)b;
-			DO_CRC(*p++);
-			b = (void *)p;
-		} while (--len);
+	return product;
+}
+
+/*
+ * Advance a reflected crc over len zero bytes, i.e. multiply it by
+ * x^(8 * len) modulo the polynomial, in O(log(len)) steps.
+ */
+static u32 __attribute_const__ crc32_generic_shift(u32 crc, size_t len,
+						   u32 polynomial)
+{
+	u32 power = polynomial;	/* CRC of x^32 */
+	int i;
+
+	/* Shift up to 32 bits in the simple linear way */
+	for (i = 0; i < 8 * (int)(len & 3); i++)
+		crc = (crc >> 1) ^ (crc & 1 ? polynomial : 0);
+
+	len >>= 2;
+	if (!len)
+		return crc;
+
+	for (;;) {
+		/* "power" is x^(2^i), modulo the polynomial */
+		if (len & 1)
+			crc = gf2_multiply(crc, power, polynomial);
+
+		len >>= 1;
+		if (!len)
+			break;
+
+		/* Square power, advancing to x^(2^(i+1)) */
+		power = gf2_multiply(power, power, polynomial);
 	}
-	return __be32_to_cpu(crc);
-#undef ENDIAN_SHIFT
-#undef DO_CRC
 
-# elif CRC_BE_BITS == 4
+	return crc;
+}
+
+/**
+ * crc32_le_combine() - Combine the crc32 of two adjacent buffers
+ * @crc1: crc32_le() of the first buffer, with whatever seed it used
+ * @crc2: crc32_le() of the second buffer, seeded with 0
+ * @len2: length of the second buffer
+ *
+ * Returns the crc32_le() of the concatenation, as if it had been run over
+ * both buffers with the first buffer's seed.  This lets large buffers be
+ * checksummed in chunks, e.g. on several CPUs, and joined afterwards.
+ */
+u32 __attribute_const__ crc32_le_combine(u32 crc1, u32 crc2, size_t len2)
+{
+	return crc32_generic_shift(crc1, len2, CRCPOLY_LE) ^ crc2;
+}
+
+/**
+ * __crc32c_le_combine() - Combine the crc32c of two adjacent buffers
+ * @crc1: __crc32c_le() of the first buffer, with whatever seed it used
+ * @crc2: __crc32c_le() of the second buffer, seeded with 0
+ * @len2: length of the second buffer
+ *
+ * The CRC32c counterpart of crc32_le_combine().
+ */
+u32 __attribute_const__ __crc32c_le_combine(u32 crc1, u32 crc2, size_t len2)
+{
+	return crc32_generic_shift(crc1, len2, CRC32C_POLY_LE) ^ crc2;
+}
+
+EXPORT_SYMBOL(crc32_le_combine);
+EXPORT_SYMBOL(__crc32c_le_combine);
+
+#if CRC_LE_BITS == 8 && CRC_BE_BITS == 8
+
+#define BENCH_SIZE	(PAGE_SIZE)
+
+/* Reference implementations for the self-test, one bit at a time */
+static u32 __init crc32_le_bitwise(u32 crc, unsigned char const *p,
+				   size_t len, u32 polynomial)
+{
+	int i;
+
 	while (len--) {
-		crc ^= *p++ << 24;
-		crc = (crc << 4) ^ crc32table_be[crc >> 28];
-		crc = (crc << 4) ^ crc32table_be[crc >> 28];
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
 	}
 	return crc;
-# elif CRC_BE_BITS == 2
+}
+
+static u32 __init crc32_be_bitwise(u32 crc, unsigned char const *p,
+				   size_t len)
+{
+	int i;
+
 	while (len--) {
 		crc ^= *p++ << 24;
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
+		for (i = 0; i < 8; i++)
+			crc = (crc << 1) ^
+			      ((crc & 0x80000000) ? CRCPOLY_BE : 0);
 	}
 	return crc;
-# endif
 }
-#endif
 
-EXPORT_SYMBOL(crc32_le);
-EXPORT_SYMBOL(crc32_be);
+static u32 __init crc32_test_le(struct crc32_template *tmpl, u32 crc,
+				unsigned char const *p, size_t len,
+				const u32 (*tab)[256])
+{
+	return __le32_to_cpu(tmpl->body(__cpu_to_le32(crc), p, len, tab));
+}
+
+static u32 __init crc32_test_be(struct crc32_template *tmpl, u32 crc,
+				unsigned char const *p, size_t len)
+{
+	return __be32_to_cpu(tmpl->body(__cpu_to_be32(crc), p, len,
+				(const u32 (*)[256])crc32table_be));
+}
+
+/*
+ * Check one loop against the bitwise code for all three CRCs, at every
+ * alignment and for lengths that exercise the head and tail handling.
+ * The loop is called directly so that a broken one is never installed.
+ */
+static int __init crc32_test_body(struct crc32_template *tmpl,
+				  unsigned char *buf)
+{
+	static const size_t lens[] __initconst = { 0, 1, 3, 7, 8, 15, 16,
+						   31, 63, 64, 257, 1000 };
+	static unsigned char const check[] __initconst = "123456789";
+	const u32 (*le)[256] = (const u32 (*)[256])crc32table_le;
+	const u32 (*c)[256] = (const u32 (*)[256])crc32ctable_le;
+	unsigned char *p;
+	unsigned int off, i;
+	size_t len;
+	u32 seed;
+
+	for (off = 0; off < 8; off++) {
+		for (i = 0; i < ARRAY_SIZE(lens); i++) {
+			seed = off * 0x9e3779b9 + i;
+			p = buf + off;
+			len = lens[i];
+			if (crc32_test_le(tmpl, seed, p, len, le) !=
+			    crc32_le_bitwise(seed, p, len, CRCPOLY_LE))
+				return -EINVAL;
+			if (crc32_test_le(tmpl, seed, p, len, c) !=
+			    crc32_le_bitwise(seed, p, len, CRC32C_POLY_LE))
+				return -EINVAL;
+			if (crc32_test_be(tmpl, seed, p, len) !=
+			    crc32_be_bitwise(seed, p, len))
+				return -EINVAL;
+		}
+	}
+
+	/* The standard check values of CRC-32, CRC-32C and CRC-32/BZIP2 */
+	if (~crc32_test_le(tmpl, ~0, check, 9, le) != 0xcbf43926 ||
+	    ~crc32_test_le(tmpl, ~0, check, 9, c) != 0xe3069283 ||
+	    ~crc32_test_be(tmpl, ~0, check, 9) != 0xfc891918)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int __init crc32_test_combine(unsigned char *buf)
+{
+	size_t len1, len2;
+	u32 crc1, crc2;
+
+	for (len1 = 0; len1 <= 96; len1 += 13) {
+		for (len2 = 0; len2 <= 1000; len2 += 111) {
+			crc1 = crc32_le(~0, buf, len1);
+			crc2 = crc32_le(0, buf + len1, len2);
+			if (crc32_le_combine(crc1, crc2, len2) !=
+			    crc32_le(~0, buf, len1 + len2))
+				return -EINVAL;
+
+			crc1 = __crc32c_le(~0, buf, len1);
+			crc2 = __crc32c_le(0, buf + len1, len2);
+			if (__crc32c_le_combine(crc1, crc2, len2) !=
+			    __crc32c_le(~0, buf, len1 + len2))
+				return -EINVAL;
+		}
+	}
+	return 0;
+}
+
+static void __init crc32_speed(struct crc32_template *tmpl, void *buf)
+{
+	int speed;
+	unsigned long now;
+	int i, count, max;
+
+	/*
+	 * Count the number of checksums done during a whole jiffy, and use
+	 * this to calculate the speed, as calibrate_xor_blocks() does.
+	 */
+	max = 0;
+	for (i = 0; i < 3; i++) {
+		now = jiffies;
+		count = 0;
+		while (jiffies == now) {
+			mb(); /* prevent loop optimzation */
+			tmpl->body(0, buf, BENCH_SIZE,
+				   (const u32 (*)[256])crc32ctable_le);
+			mb();
+			count++;
+			mb();
+		}
+		if (count > max)
+			max = count;
+	}
+
+	speed = max * (HZ * BENCH_SIZE / 1024);
+	tmpl->speed = speed;
+
+	printk(KERN_INFO "   %-10s: %5d.%03d MB/sec\n", tmpl->name,
+	       speed / 1000, speed % 1000);
+}
+
+static int __init crc32_calibrate(void)
+{
+	struct crc32_template *tmpl, *fastest = NULL;
+	unsigned char *buf;
+	unsigned int i;
+	u32 x = 0;
+
+	buf = (unsigned char *)__get_free_page(GFP_KERNEL);
+	if (!buf) {
+		printk(KERN_WARNING "crc32: no memory for self-test, "
+		       "using slice-by-8\n");
+		return 0;
+	}
+
+	for (i = 0; i < BENCH_SIZE; i++) {
+		x = x * 1103515245 + 12345;
+		buf[i] = x >> 16;
+	}
+
+	printk(KERN_INFO "crc32: self-test and speed of table-driven "
+	       "implementations\n");
+	for (i = 0; i < ARRAY_SIZE(crc32_templates); i++) {
+		tmpl = &crc32_templates[i];
+		if (crc32_test_body(tmpl, buf)) {
+			printk(KERN_ERR "crc32: %s failed self-test\n",
+			       tmpl->name);
+			continue;
+		}
+		crc32_speed(tmpl, buf);
+		if (!fastest || tmpl->speed > fastest->speed)
+			fastest = tmpl;
+	}
+
+	if (!fastest) {
+		printk(KERN_ERR "crc32: all implementations failed "
+		       "self-test\n");
+		goto out;
+	}
+
+	crc32_body = fastest->body;
+	if (crc32_test_combine(buf))
+		printk(KERN_ERR "crc32: crc32_le_combine failed self-test\n");
+
+	printk(KERN_INFO "crc32: using function: %s (%d.%03d MB/sec)\n",
+	       fastest->name, fastest->speed / 1000, fastest->speed % 1000);
+
+out:
+	free_page((unsigned long)buf);
+	return 0;
+}
+
+static void __exit crc32_exit(void)
+{
+}
+
+/* when built-in, pick the loop before most users start checksumming */
+core_initcall(crc32_calibrate);
+module_exit(crc32_exit);
+
+#endif /* CRC_LE_BITS == 8 && CRC_BE_BITS == 8 */
 
 /*
  * A brief CRC tutorial.
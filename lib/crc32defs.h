@@ -6,8 +6,19 @@
 #define CRCPOLY_LE 0xedb88320
 #define CRCPOLY_BE 0x04c11db7
 
-/* How many bits at a time to use.  Requires a table of 4<<CRC_xx_BITS bytes. */
-/* For less performance-sensitive, use 4 */
+/*
+ * This is the CRC32c polynomial, as outlined by Castagnoli.
+ * x^32+x^28+x^27+x^26+x^25+x^23+x^22+x^20+x^19+x^18+x^14+x^13+x^11+x^10+x^9+
+ * x^8+x^6+x^0
+ */
+#define CRC32C_POLY_LE 0x82F63B78
+
+/*
+ * How many bits at a time to use.  Requires a table of 4<<CRC_xx_BITS bytes,
+ * except for 8, which generates eight such tables so that the slice-by-4
+ * and slice-by-8 loops can be used as well.  For less performance-sensitive,
+ * use 4.
+ */
 #ifndef CRC_LE_BITS 
 # define CRC_LE_BITS 8
 #endif
@@ -14,9 +14,22 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/lzo.h>
+#include <asm/byteorder.h>
 #include <asm/unaligned.h>
 #include "lzodefs.h"
 
+#ifdef LZO_USE_UNALIGNED
+/* Number of leading bytes in memory order that are equal, given v != 0 */
+static inline unsigned int lzo_equal_bytes(u32 v)
+{
+#ifdef __LITTLE_ENDIAN
+	return __ffs(v) >> 3;
+#else
+	return (31 - __fls(v)) >> 3;
+#endif
+}
+#endif
+
 static noinline size_t
 _lzo1x_1_do_compress(const unsigned char *in, size_t in_len,
 		unsigned char *out, size_t *out_len, void *wrkmem)
@@ -93,9 +106,29 @@ match:
 				}
 				*op++ = tt;
 			}
+#ifdef LZO_USE_UNALIGNED
+			/*
+			 * ip is well short of the input end here, and the
+			 * output buffer is sized by lzo1x_worst_compress(),
+			 * which leaves far more slack than the up to 7 bytes
+			 * this writes past the literals.
+			 */
+			{
+				unsigned char *oe = op + t;
+
+				do {
+					COPY8(op, ii);
+					op += 8;
+					ii += 8;
+				} while (op < oe);
+				op = oe;
+				ii = ip;
+			}
+#else
 			do {
 				*op++ = *ii++;
 			} while (--t > 0);
+#endif
 		}
 
 		ip += 3;
@@ -125,10 +158,25 @@ match:
 			end = in_end;
 			m = m_pos + M2_MAX_LEN + 1;
 
+#ifdef LZO_USE_UNALIGNED
+			while (end - ip >= 4) {
+				u32 v = *(const u32 *)m ^ *(const u32 *)ip;
+
+				if (v) {
+					ip += lzo_equal_bytes(v);
+					goto m_len_done;
+				}
+				m += 4;
+				ip += 4;
+			}
+#endif
 			while (ip < end && *m == *ip) {
 				m++;
 				ip++;
 			}
+#ifdef LZO_USE_UNALIGNED
+m_len_done:
+#endif
 			m_len = ip - ii;
 
 			if (m_off <= M3_MAX_OFFSET) {
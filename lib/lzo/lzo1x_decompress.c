@@ -13,6 +13,7 @@
 
 #include <linux/module.h>
 #include <linux/kernel.h>
+#include <linux/string.h>
 #include <linux/lzo.h>
 #include <asm/byteorder.h>
 #include <asm/unaligned.h>
@@ -22,8 +23,8 @@
 #define HAVE_OP(x, op_end, op) ((size_t)(op_end - op) < (x))
 #define HAVE_LB(m_pos, out, op) (m_pos < out || m_pos >= op)
 
-#define COPY4(dst, src)	\
-		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
+/* Longest run length that cannot wrap around when the last byte is added */
+#define MAX_RUN_LEN	(((size_t)~0) - 2 * 255)
 
 int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 			unsigned char *out, size_t *out_len)
@@ -36,6 +37,10 @@ int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 
 	*out_len = 0;
 
+	/* Even an empty stream carries the three byte end marker */
+	if (unlikely(in_len < 3))
+		goto input_overrun;
+
 	if (*ip > 17) {
 		t = *ip++ - 17;
 		if (t < 4)
@@ -44,6 +49,21 @@ int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 			goto output_overrun;
 		if (HAVE_IP(t + 1, ip_end, ip))
 			goto input_overrun;
+#ifdef LZO_USE_UNALIGNED
+		if (!HAVE_OP(t + 7, op_end, op) && !HAVE_IP(t + 7, ip_end, ip)) {
+			const unsigned char *ie = ip + t;
+			unsigned char *oe = op + t;
+
+			do {
+				COPY8(op, ip);
+				op += 8;
+				ip += 8;
+			} while (ip < ie);
+			ip = ie;
+			op = oe;
+			goto first_literal_run;
+		}
+#endif
 		do {
 			*op++ = *ip++;
 		} while (--t > 0);
@@ -60,6 +80,8 @@ int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 			while (*ip == 0) {
 				t += 255;
 				ip++;
+				if (unlikely(t > MAX_RUN_LEN))
+					goto error;
 				if (HAVE_IP(1, ip_end, ip))
 					goto input_overrun;
 			}
@@ -70,6 +92,27 @@ int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 		if (HAVE_IP(t + 4, ip_end, ip))
 			goto input_overrun;
 
+#ifdef LZO_USE_UNALIGNED
+		/*
+		 * Copy the whole run in 8-byte steps when both buffers have
+		 * room for the overshoot; the bytes written past the run are
+		 * overwritten by whatever is decoded next.
+		 */
+		if (!HAVE_OP(t + 3 + 7, op_end, op) &&
+		    !HAVE_IP(t + 3 + 7, ip_end, ip)) {
+			const unsigned char *ie = ip + t + 3;
+			unsigned char *oe = op + t + 3;
+
+			do {
+				COPY8(op, ip);
+				op += 8;
+				ip += 8;
+			} while (ip < ie);
+			ip = ie;
+			op = oe;
+			goto first_literal_run;
+		}
+#endif
 		COPY4(op, ip);
 		op += 4;
 		ip += 4;
@@ -97,6 +140,8 @@ first_literal_run:
 		t = *ip++;
 		if (t >= 16)
 			goto match;
+		if (HAVE_IP(1, ip_end, ip))
+			goto input_overrun;
 		m_pos = op - (1 + M2_MAX_OFFSET);
 		m_pos -= t >> 2;
 		m_pos -= *ip++ << 2;
@@ -115,15 +160,12 @@ first_literal_run:
 		do {
 match:
 			if (t >= 64) {
+				if (HAVE_IP(1, ip_end, ip))
+					goto input_overrun;
 				m_pos = op - 1;
 				m_pos -= (t >> 2) & 7;
 				m_pos -= *ip++ << 3;
 				t = (t >> 5) - 1;
-				if (HAVE_LB(m_pos, out, op))
-					goto lookbehind_overrun;
-				if (HAVE_OP(t + 3 - 1, op_end, op))
-					goto output_overrun;
-				goto copy_match;
 			} else if (t >= 32) {
 				t &= 31;
 				if (t == 0) {
@@ -132,11 +174,15 @@ match:
 					while (*ip == 0) {
 						t += 255;
 						ip++;
+						if (unlikely(t > MAX_RUN_LEN))
+							goto error;
 						if (HAVE_IP(1, ip_end, ip))
 							goto input_overrun;
 					}
 					t += 31 + *ip++;
 				}
+				if (HAVE_IP(2, ip_end, ip))
+					goto input_overrun;
 				m_pos = op - 1;
 				m_pos -= get_unaligned_le16(ip) >> 2;
 				ip += 2;
@@ -151,17 +197,23 @@ match:
 					while (*ip == 0) {
 						t += 255;
 						ip++;
+						if (unlikely(t > MAX_RUN_LEN))
+							goto error;
 						if (HAVE_IP(1, ip_end, ip))
 							goto input_overrun;
 					}
 					t += 7 + *ip++;
 				}
+				if (HAVE_IP(2, ip_end, ip))
+					goto input_overrun;
 				m_pos -= get_unaligned_le16(ip) >> 2;
 				ip += 2;
 				if (m_pos == op)
 					goto eof_found;
 				m_pos -= 0x4000;
 			} else {
+				if (HAVE_IP(1, ip_end, ip))
+					goto input_overrun;
 				m_pos = op - 1;
 				m_pos -= t >> 2;
 				m_pos -= *ip++ << 2;
@@ -181,7 +233,28 @@ match:
 			if (HAVE_OP(t + 3 - 1, op_end, op))
 				goto output_overrun;
 
-			if (t >= 2 * 4 - (3 - 1) && (op - m_pos) >= 4) {
+#ifdef LZO_USE_UNALIGNED
+			/*
+			 * With the source at least 8 bytes back every word read
+			 * has already been written, so short matches take a
+			 * single overlapping 8-byte copy.
+			 */
+			if (op - m_pos >= 8 && !HAVE_OP(t + 2 + 7, op_end, op)) {
+				unsigned char *oe = op + t + 2;
+
+				do {
+					COPY8(op, m_pos);
+					op += 8;
+					m_pos += 8;
+				} while (op < oe);
+				op = oe;
+				goto match_done;
+			}
+#endif
+			if (op - m_pos == 1 && t >= 16) {
+				memset(op, *m_pos, t + 2);
+				op += t + 2;
+			} else if (t >= 2 * 4 - (3 - 1) && (op - m_pos) >= 4) {
 				COPY4(op, m_pos);
 				op += 4;
 				m_pos += 4;
@@ -197,7 +270,6 @@ match:
 						*op++ = *m_pos++;
 					} while (--t > 0);
 			} else {
-copy_match:
 				*op++ = *m_pos++;
 				*op++ = *m_pos++;
 				do {
@@ -209,6 +281,15 @@ match_done:
 			if (t == 0)
 				break;
 match_next:
+#ifdef LZO_USE_UNALIGNED
+			if (!HAVE_OP(4, op_end, op) && !HAVE_IP(4, ip_end, ip)) {
+				COPY4(op, ip);
+				op += t;
+				ip += t;
+				t = *ip++;
+				continue;
+			}
+#endif
 			if (HAVE_OP(t, op_end, op))
 				goto output_overrun;
 			if (HAVE_IP(t + 1, ip_end, ip))
@@ -243,6 +324,10 @@ output_overrun:
 lookbehind_overrun:
 	*out_len = op - out;
 	return LZO_E_LOOKBEHIND_OVERRUN;
+
+error:
+	*out_len = op - out;
+	return LZO_E_ERROR;
 }
 
 EXPORT_SYMBOL_GPL(lzo1x_decompress_safe);
@@ -0,0 +1,332 @@
+/*
+ *  Self test and benchmark for the LZO1X compressor and decompressor
+ *
+ *  Every block of a small synthetic corpus is compressed and
+ *  decompressed again, the decompressor is fed truncated and corrupted
+ *  streams, and the throughput of both directions is reported.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  version 2 as published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
+#include <linux/lzo.h>
+
+#define LZO_TEST_BLOCK		4096
+#define LZO_TEST_BLOCKS		64
+#define LZO_TEST_SIZE		(LZO_TEST_BLOCK * LZO_TEST_BLOCKS)
+#define LZO_TEST_CBLOCK		lzo1x_worst_compress(LZO_TEST_BLOCK)
+#define LZO_TEST_GUARD		32
+#define LZO_TEST_NS		(100 * NSEC_PER_MSEC)
+
+static unsigned char *raw, *cdata, *out, *wrkmem;
+static size_t clen[LZO_TEST_BLOCKS];
+static u32 lzo_test_seed;
+
+/* Deterministic so that the ratios are comparable between runs */
+static u32 lzo_test_rand(void)
+{
+	lzo_test_seed ^= lzo_test_seed << 13;
+	lzo_test_seed ^= lzo_test_seed >> 17;
+	lzo_test_seed ^= lzo_test_seed << 5;
+	return lzo_test_seed;
+}
+
+static void fill_zero(unsigned char *buf, size_t len)
+{
+	memset(buf, 0, len);
+}
+
+static const char * const lzo_test_words[] = {
+	"the", "of", "and", "to", "in", "is", "that", "for", "it", "as",
+	"with", "was", "on", "be", "by", "this", "from", "at", "which", "or",
+	"kernel", "page", "memory", "device", "driver", "buffer", "return",
+	"interrupt", "function", "structure", "compressed", "swap", "image",
+};
+
+static void fill_text(unsigned char *buf, size_t len)
+{
+	size_t i = 0;
+
+	while (i < len) {
+		const char *w = lzo_test_words[lzo_test_rand() %
+					       ARRAY_SIZE(lzo_test_words)];
+
+		while (*w && i < len)
+			buf[i++] = *w++;
+		if (i < len)
+			buf[i++] = (lzo_test_rand() & 15) ? ' ' : '\n';
+	}
+}
+
+static void fill_log(unsigned char *buf, size_t len)
+{
+	char line[96];
+	unsigned int n = 0;
+	size_t i = 0;
+
+	while (i < len) {
+		int l = snprintf(line, sizeof(line),
+				 "<%u>[%5u.%06u] %s: %s %u bytes at %08x\n",
+				 lzo_test_rand() & 7, n / 50,
+				 lzo_test_rand() % 1000000,
+				 lzo_test_words[20 + n % 13],
+				 lzo_test_words[lzo_test_rand() % 20],
+				 lzo_test_rand() & 0xfff,
+				 0xc0000000 | (lzo_test_rand() & 0xffff0));
+
+		l = min_t(size_t, l, len - i);
+		memcpy(buf + i, line, l);
+		i += l;
+		n++;
+	}
+}
+
+/* Looks like slab or anonymous memory: pointers, small counters, holes */
+static void fill_struct(unsigned char *buf, size_t len)
+{
+	u32 *p = (u32 *)buf;
+	size_t i;
+
+	for (i = 0; i < len / 4; i++) {
+		switch (i & 7) {
+		case 0:
+		case 1:
+			p[i] = 0xc0000000 | (lzo_test_rand() & 0x3ffffc0);
+			break;
+		case 2:
+			p[i] = lzo_test_rand() & 0xff;
+			break;
+		case 3:
+			p[i] = i;
+			break;
+		default:
+			p[i] = (lzo_test_rand() & 3) ? 0 : lzo_test_rand();
+			break;
+		}
+	}
+}
+
+static void fill_random(unsigned char *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = lzo_test_rand();
+}
+
+static const struct {
+	const char *name;
+	void (*fill)(unsigned char *buf, size_t len);
+} lzo_test_corpus[] = {
+	{ "zero",	fill_zero },
+	{ "text",	fill_text },
+	{ "log",	fill_log },
+	{ "struct",	fill_struct },
+	{ "random",	fill_random },
+};
+
+/*
+ * Decompress @src into @out with room for @avail bytes and a guard
+ * area behind it that must come back untouched.
+ */
+static int lzo_test_decompress(const unsigned char *src, size_t len,
+			       size_t avail, size_t *out_len)
+{
+	int ret, i;
+
+	memset(out + avail, 0xa5, LZO_TEST_GUARD);
+	*out_len = avail;
+	ret = lzo1x_decompress_safe(src, len, out, out_len);
+
+	for (i = 0; i < LZO_TEST_GUARD; i++) {
+		if (out[avail + i] != 0xa5) {
+			printk(KERN_ERR "lzo_test: write past the output "
+			       "buffer (%zu bytes)\n", avail);
+			return -EFAULT;
+		}
+	}
+	if (*out_len > avail) {
+		printk(KERN_ERR "lzo_test: bad output length %zu > %zu\n",
+		       *out_len, avail);
+		return -EFAULT;
+	}
+	return ret;
+}
+
+static int lzo_test_roundtrip(const unsigned char *src, size_t len,
+			      unsigned char *dst, size_t *zlen)
+{
+	size_t dlen;
+	int ret;
+
+	ret = lzo1x_1_compress(src, len, dst, zlen, wrkmem);
+	if (ret != LZO_E_OK || *zlen > lzo1x_worst_compress(len))
+		goto fail;
+
+	ret = lzo_test_decompress(dst, *zlen, len, &dlen);
+	if (ret != LZO_E_OK || dlen != len || memcmp(out, src, len))
+		goto fail;
+
+	/* One byte short of room must be caught */
+	if (len && lzo_test_decompress(dst, *zlen, len - 1, &dlen) !=
+	    LZO_E_OUTPUT_OVERRUN)
+		goto fail;
+
+	return 0;
+
+fail:
+	printk(KERN_ERR "lzo_test: round trip of %zu bytes failed (%d)\n",
+	       len, ret);
+	return -EINVAL;
+}
+
+/* Malformed streams may fail any way they like, but must stay in bounds */
+static int lzo_test_fuzz(const unsigned char *src, size_t len)
+{
+	unsigned char *bad = cdata + LZO_TEST_CBLOCK;
+	size_t dlen, i;
+	int ret;
+
+	for (i = 0; i < len; i++) {
+		ret = lzo_test_decompress(src, i, LZO_TEST_BLOCK, &dlen);
+		if (ret == LZO_E_OK || ret == -EFAULT) {
+			printk(KERN_ERR "lzo_test: stream truncated to %zu "
+			       "of %zu bytes not caught (%d)\n", i, len, ret);
+			return -EINVAL;
+		}
+	}
+
+	for (i = 0; i < 256; i++) {
+		memcpy(bad, src, len);
+		bad[lzo_test_rand() % len] ^= 1 << (lzo_test_rand() & 7);
+		if (i & 1)
+			bad[lzo_test_rand() % len] = lzo_test_rand();
+		if (lzo_test_decompress(bad, len, LZO_TEST_BLOCK, &dlen) ==
+		    -EFAULT)
+			return -EINVAL;
+	}
+	return 0;
+}
+
+static unsigned int lzo_test_mbps(u64 bytes, s64 ns)
+{
+	return div64_u64((bytes >> 10) * NSEC_PER_SEC,
+			 max_t(s64, ns, 1)) >> 10;
+}
+
+static int __init lzo_test_corpus_run(int c)
+{
+	unsigned int ratio, cmbps, dmbps;
+	u64 bytes, total = 0;
+	ktime_t start;
+	s64 ns;
+	size_t dlen;
+	int i, ret;
+
+	lzo_test_seed = 0x2545f491 + c;
+	lzo_test_corpus[c].fill(raw, LZO_TEST_SIZE);
+
+	for (i = 0; i < LZO_TEST_BLOCKS; i++) {
+		unsigned char *src = raw + i * LZO_TEST_BLOCK;
+
+		/* The streams are kept for the timed decompression below */
+		if (lzo_test_roundtrip(src, LZO_TEST_BLOCK,
+				       cdata + (i + 2) * LZO_TEST_CBLOCK,
+				       &clen[i]))
+			return -EINVAL;
+		total += clen[i];
+	}
+	ratio = div64_u64(total * 100, LZO_TEST_SIZE);
+
+	if (lzo_test_fuzz(cdata + 2 * LZO_TEST_CBLOCK, clen[0]))
+		return -EINVAL;
+
+	bytes = 0;
+	start = ktime_get();
+	do {
+		for (i = 0; i < LZO_TEST_BLOCKS; i++)
+			lzo1x_1_compress(raw + i * LZO_TEST_BLOCK,
+					 LZO_TEST_BLOCK, cdata, &dlen, wrkmem);
+		bytes += LZO_TEST_SIZE;
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	} while (ns < LZO_TEST_NS);
+	cmbps = lzo_test_mbps(bytes, ns);
+
+	bytes = 0;
+	start = ktime_get();
+	do {
+		for (i = 0; i < LZO_TEST_BLOCKS; i++) {
+			dlen = LZO_TEST_BLOCK;
+			ret = lzo1x_decompress_safe(cdata +
+					(i + 2) * LZO_TEST_CBLOCK,
+					clen[i], out, &dlen);
+			if (ret != LZO_E_OK)
+				return -EINVAL;
+		}
+		bytes += LZO_TEST_SIZE;
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	} while (ns < LZO_TEST_NS);
+	dmbps = lzo_test_mbps(bytes, ns);
+
+	printk(KERN_INFO "lzo_test: %-6s ratio %3u%%  compress %5u MB/s  "
+	       "decompress %5u MB/s\n", lzo_test_corpus[c].name, ratio,
+	       cmbps, dmbps);
+	return 0;
+}
+
+static int __init lzo_test_init(void)
+{
+	size_t len, off, zlen;
+	int c, ret = -ENOMEM;
+
+	raw = vmalloc(LZO_TEST_SIZE);
+	cdata = vmalloc((LZO_TEST_BLOCKS + 2) * LZO_TEST_CBLOCK);
+	out = vmalloc(LZO_TEST_BLOCK + LZO_TEST_GUARD);
+	wrkmem = vmalloc(LZO1X_MEM_COMPRESS);
+	if (!raw || !cdata || !out || !wrkmem)
+		goto out;
+
+	ret = -EINVAL;
+
+	/* Short and odd lengths at every alignment hit all the tail cases */
+	lzo_test_seed = 1;
+	fill_text(raw, LZO_TEST_SIZE);
+	for (off = 0; off < 4; off++)
+		for (len = 0; len <= 300; len++)
+			if (lzo_test_roundtrip(raw + off, len, cdata, &zlen))
+				goto out;
+
+	for (c = 0; c < ARRAY_SIZE(lzo_test_corpus); c++)
+		if (lzo_test_corpus_run(c))
+			goto out;
+
+	printk(KERN_INFO "lzo_test: all tests passed\n");
+	ret = 0;
+out:
+	if (ret == -EINVAL)
+		printk(KERN_ERR "lzo_test: FAILED\n");
+	vfree(wrkmem);
+	vfree(out);
+	vfree(cdata);
+	vfree(raw);
+	return ret;
+}
+
+static void __exit lzo_test_exit(void)
+{
+}
+
+module_init(lzo_test_init);
+module_exit(lzo_test_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZO1X self test and benchmark");
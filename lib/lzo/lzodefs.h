@@ -41,3 +41,33 @@
 #define DX2(p, s1, s2)	(((((size_t)((p)[2]) << (s2)) ^ (p)[1]) \
 							<< (s1)) ^ (p)[0])
 #define DX3(p, s1, s2, s3)	((DX2((p)+1, s2, s3) << (s1)) ^ (p)[0])
+
+/*
+ * Define LZO_USE_UNALIGNED when plain word loads and stores may be
+ * unaligned and are cheap.  ARMv6 and later do this in hardware for
+ * ldr/str once the alignment trap is disabled (see arch/arm/mm/alignment.c),
+ * but ldm/ldrd still fault, so two word copies are kept apart with a
+ * compiler barrier to stop them being merged.
+ */
+#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS) || \
+	(defined(CONFIG_ARM) && defined(CONFIG_MMU) && __LINUX_ARM_ARCH__ >= 6)
+#define LZO_USE_UNALIGNED
+
+#define COPY4(dst, src)	(*(u32 *)(dst) = *(const u32 *)(src))
+#if defined(CONFIG_ARM)
+#define COPY8(dst, src)					\
+		do {						\
+			COPY4(dst, src);			\
+			barrier();				\
+			COPY4((dst) + 4, (src) + 4);		\
+		} while (0)
+#elif BITS_PER_LONG == 64
+#define COPY8(dst, src)	(*(u64 *)(dst) = *(const u64 *)(src))
+#else
+#define COPY8(dst, src)	\
+		do { COPY4(dst, src); COPY4((dst) + 4, (src) + 4); } while (0)
+#endif
+#else
+#define COPY4(dst, src)	\
+		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
+#endif
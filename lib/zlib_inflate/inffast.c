@@ -4,6 +4,7 @@
  */
 
 #include <linux/zutil.h>
+#include <asm/byteorder.h>
 #include "inftrees.h"
 #include "inflate.h"
 #include "inffast.h"
@@ -29,6 +30,123 @@
 #  define PUP(a) *++(a)
 #endif
 
+/*
+   Input bit buffer refill.  On 64-bit machines with cheap unaligned loads
+   hold has room for 32 new bits whenever fewer than 32 are left, so one
+   four byte load replaces up to four single byte refills per
+   length/distance pair.  Elsewhere two bytes are fetched at a time as
+   before, in a single load where the CPU allows it.  p points at the next
+   input byte.
+ */
+static inline unsigned long zlib_get_le16(const unsigned char *p)
+{
+#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS) && defined(__LITTLE_ENDIAN)
+    return *(const unsigned short *)p;
+#else
+    return p[0] | ((unsigned)p[1] << 8);
+#endif
+}
+
+#ifdef INFLATE_FAST_REFILL32
+static inline unsigned long zlib_get_le32(const unsigned char *p)
+{
+#ifdef __LITTLE_ENDIAN
+    return *(const unsigned int *)p;
+#else
+    return p[0] | ((unsigned)p[1] << 8) | ((unsigned)p[2] << 16) |
+           ((unsigned)p[3] << 24);
+#endif
+}
+
+#  define REFILL() \
+    do { \
+        if (bits < 32) { \
+            hold += zlib_get_le32(in + OFF) << bits; \
+            in += 4; \
+            bits += 32; \
+        } \
+    } while (0)
+#else
+#  define REFILL() \
+    do { \
+        if (bits < 15) { \
+            hold += zlib_get_le16(in + OFF) << bits; \
+            in += 2; \
+            bits += 16; \
+        } \
+    } while (0)
+#endif
+
+/*
+   Copy a match of len bytes from dist bytes back in the output.  Whole
+   words are moved only where that gives the same result as the byte copy:
+   for a run of a single byte, or when the source is at least a word
+   behind.  Between one and two words behind, each load would straddle the
+   previous store, which stalls store forwarding, so only exactly one word
+   is used there.  Without efficient unaligned access dist must also be a
+   multiple of the word size, so that out and from can be aligned
+   together.  out points at the next output byte; the new value is
+   returned.
+ */
+static inline unsigned char *zlib_copy_match(unsigned char *out,
+                                             unsigned dist, unsigned len)
+{
+    const unsigned wsize = sizeof(unsigned long);
+    const unsigned char *from;
+    unsigned long pat;
+
+    if (dist == 1) {                            /* run of one byte */
+        pat = out[-1] * (~0UL / 0xff);
+        while (len && ((long)out & (wsize - 1))) {
+            *out++ = (unsigned char)pat;
+            len--;
+        }
+        while (len >= wsize) {
+            *(unsigned long *)out = pat;
+            out += wsize;
+            len -= wsize;
+        }
+    }
+#ifdef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
+    else if (dist == wsize || dist >= 2 * wsize) {
+        from = out - dist;
+        while (len >= wsize) {
+            *(unsigned long *)out = *(const unsigned long *)from;
+            out += wsize;
+            from += wsize;
+            len -= wsize;
+        }
+    }
+#else
+    else if ((dist & (wsize - 1)) == 0) {       /* same alignment */
+        from = out - dist;
+        while (len && ((long)out & (wsize - 1))) {
+            *out++ = *from++;
+            len--;
+        }
+        while (len >= wsize) {
+            *(unsigned long *)out = *(const unsigned long *)from;
+            out += wsize;
+            from += wsize;
+            len -= wsize;
+        }
+    }
+#endif
+    from = out - dist;
+    while (len > 2) {
+        *out++ = *from++;
+        *out++ = *from++;
+        *out++ = *from++;
+        len -= 3;
+    }
+    if (len) {
+        *out++ = *from++;
+        if (len > 1)
+            *out++ = *from++;
+    }
+    return out;
+}
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -40,8 +158,8 @@
    Entry assumptions:
 
         state->mode == LEN
-        strm->avail_in >= 6
-        strm->avail_out >= 258
+        strm->avail_in >= INFLATE_FAST_MIN_HAVE
+        strm->avail_out >= INFLATE_FAST_MIN_LEFT
         start >= strm->avail_out
         state->bits < 8
 
@@ -57,7 +175,9 @@
       length code, 5 bits for the length extra, 15 bits for the distance code,
       and 13 bits for the distance extra.  This totals 48 bits, or six bytes.
       Therefore if strm->avail_in >= 6, then there is enough input to avoid
-      checking for available input while decoding.
+      checking for available input while decoding.  The four byte refills
+      of INFLATE_FAST_REFILL32 can read up to eight bytes for one pair, so
+      there INFLATE_FAST_MIN_HAVE is 8.
 
     - The maximum bytes that a single length/distance pair can output is 258
       bytes, which is the maximum length that can be coded.  inflate_fast()
@@ -97,7 +217,7 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* copy state to local variables */
     state = (struct inflate_state *)strm->state;
     in = strm->next_in - OFF;
-    last = in + (strm->avail_in - 5);
+    last = in + (strm->avail_in - (INFLATE_FAST_MIN_HAVE - 1));
     out = strm->next_out - OFF;
     beg = out - (start - strm->avail_out);
     end = out + (strm->avail_out - 257);
@@ -118,12 +238,7 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* decode literals and length/distances until end-of-block or not enough
        input data or output space */
     do {
-        if (bits < 15) {
-            hold += (unsigned long)(PUP(in)) << bits;
-            bits += 8;
-            hold += (unsigned long)(PUP(in)) << bits;
-            bits += 8;
-        }
+        REFILL();
         this = lcode[hold & lmask];
       dolen:
         op = (unsigned)(this.bits);
@@ -145,12 +260,7 @@ void inflate_fast(z_streamp strm, unsigned start)
                 hold >>= op;
                 bits -= op;
             }
-            if (bits < 15) {
-                hold += (unsigned long)(PUP(in)) << bits;
-                bits += 8;
-                hold += (unsigned long)(PUP(in)) << bits;
-                bits += 8;
-            }
+            REFILL();
             this = dcode[hold & dmask];
           dodist:
             op = (unsigned)(this.bits);
@@ -238,6 +348,9 @@ void inflate_fast(z_streamp strm, unsigned start)
                             PUP(out) = PUP(from);
                     }
                 }
+                else if (len >= 16) {           /* long copy from output */
+                    out = zlib_copy_match(out + OFF, dist, len) - OFF;
+                }
                 else {
                     from = out - dist;          /* copy direct from output */
                     do {                        /* minimum length is three */
@@ -287,7 +400,9 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* update state and return */
     strm->next_in = in + OFF;
     strm->next_out = out + OFF;
-    strm->avail_in = (unsigned)(in < last ? 5 + (last - in) : 5 - (in - last));
+    strm->avail_in = (unsigned)(in < last ?
+                                (INFLATE_FAST_MIN_HAVE - 1) + (last - in) :
+                                (INFLATE_FAST_MIN_HAVE - 1) - (in - last));
     strm->avail_out = (unsigned)(out < end ?
                                  257 + (end - out) : 257 - (out - end));
     state->hold = hold;
@@ -8,4 +8,19 @@
    subject to change. Applications should only use zlib.h.
  */
 
+#include <asm/bitsperlong.h>
+
+/* refill the bit buffer four bytes at a time, see inffast.c */
+#if BITS_PER_LONG == 64 && defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)
+#  define INFLATE_FAST_REFILL32
+#endif
+
+/* input and output inflate() must have available to call inflate_fast() */
+#ifdef INFLATE_FAST_REFILL32
+#  define INFLATE_FAST_MIN_HAVE 8
+#else
+#  define INFLATE_FAST_MIN_HAVE 6
+#endif
+#define INFLATE_FAST_MIN_LEFT 258
+
 void inflate_fast (z_streamp strm, unsigned start);
@@ -551,7 +551,7 @@ int zlib_inflate(z_streamp strm, int flush)
             /* build code tables */
             state->next = state->codes;
             state->lencode = (code const *)(state->next);
-            state->lenbits = 9;
+            state->lenbits = 10;
             ret = zlib_inflate_table(LENS, state->lens, state->nlen, &(state->next),
                                 &(state->lenbits), state->work);
             if (ret) {
@@ -570,7 +570,7 @@ int zlib_inflate(z_streamp strm, int flush)
             }
             state->mode = LEN;
         case LEN:
-            if (have >= 6 && left >= 258) {
+            if (have >= INFLATE_FAST_MIN_HAVE && left >= INFLATE_FAST_MIN_LEFT) {
                 RESTORE();
                 inflate_fast(strm, out);
                 LOAD();
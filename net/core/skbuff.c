@@ -1524,15 +1524,41 @@ static int __skb_splice_bits(struct sk_buff *skb, unsigned int *offset,
 	return 0;
 }
 
+/*
+ * Default splice_cb for skb_splice_bits(). Drop the socket lock, otherwise
+ * we have reverse locking dependencies between sk_lock and i_mutex here as
+ * compared to sendfile(). We enter here with the socket lock held, and
+ * splice_to_pipe() will grab the pipe inode lock. For sendfile() emulation,
+ * we call into ->sendpage() with the i_mutex lock held and networking will
+ * grab the socket lock.
+ */
+int skb_socket_splice(struct sock *sk, struct pipe_inode_info *pipe,
+		      struct splice_pipe_desc *spd)
+{
+	int ret;
+
+	release_sock(sk);
+	ret = splice_to_pipe(pipe, spd);
+	lock_sock(sk);
+
+	return ret;
+}
+
 /*
  * Map data from the skb to a pipe. Should handle both the linear part,
  * the fragments, and the frag list. It does NOT handle frag lists within
  * the frag list, if such a thing exists. We'd probably need to recurse to
  * handle that cleanly.
+ *
+ * @sk is the socket the data is being received on; it provides the page
+ * used to copy out the linear part and is handed to @splice_cb, which does
+ * the actual splice_to_pipe() with whatever locking the caller needs.
  */
-int skb_splice_bits(struct sk_buff *skb, unsigned int offset,
+int skb_splice_bits(struct sk_buff *skb, struct sock *sk, unsigned int offset,
 		    struct pipe_inode_info *pipe, unsigned int tlen,
-		    unsigned int flags)
+		    unsigned int flags,
+		    int (*splice_cb)(struct sock *, struct pipe_inode_info *,
+				     struct splice_pipe_desc *))
 {
 	struct partial_page partial[PIPE_BUFFERS];
 	struct page *pages[PIPE_BUFFERS];
@@ -1544,7 +1570,6 @@ int skb_splice_bits(struct sk_buff *skb, unsigned int offset,
 		.spd_release = sock_spd_release,
 	};
 	struct sk_buff *frag_iter;
-	struct sock *sk = skb->sk;
 
 	/*
 	 * __skb_splice_bits() only fails if the output has no room left,
@@ -1566,26 +1591,12 @@ int skb_splice_bits(struct sk_buff *skb, unsigned int offset,
 	}
 
 done:
-	if (spd.nr_pages) {
-		int ret;
-
-		/*
-		 * Drop the socket lock, otherwise we have reverse
-		 * locking dependencies between sk_lock and i_mutex
-		 * here as compared to sendfile(). We enter here
-		 * with the socket lock held, and splice_to_pipe() will
-		 * grab the pipe inode lock. For sendfile() emulation,
-		 * we call into ->sendpage() with the i_mutex lock held
-		 * and networking will grab the socket lock.
-		 */
-		release_sock(sk);
-		ret = splice_to_pipe(pipe, &spd);
-		lock_sock(sk);
-		return ret;
-	}
+	if (spd.nr_pages)
+		return splice_cb(sk, pipe, &spd);
 
 	return 0;
 }
+EXPORT_SYMBOL_GPL(skb_splice_bits);
 
 /**
  *	skb_store_bits - store bits from kernel buffer to skb
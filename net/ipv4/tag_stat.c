@@ -0,0 +1,402 @@
+/*
+ * Per-UID socket tagged traffic accounting.
+ *
+ * Counters are kept per (uid, tag, interface) in a small hash table and
+ * are updated on the IPv4 output path and on TCP/UDP receive.  Each entry
+ * carries one cacheline of counters per CPU, so the per packet cost is a
+ * check of the entry cached in the socket and two local additions.
+ *
+ * Entries are never freed, which lets the socket cache a bare pointer
+ * without reference counting.  They are keyed by interface name, so
+ * that links such as rmnet or ppp which come and go with a new ifindex
+ * each time keep adding to the same counters.  The entry remembers the
+ * last ifindex it was seen with for the fast path; that hint is cleared
+ * when the device goes away or is renamed.
+ *
+ * Both kinds of entries are capped.  Once the tagged cap is reached
+ * traffic falls back to the untagged (tag 0) entry of the uid, and once
+ * the untagged cap is reached to that of TAG_STAT_UID_OTHER.
+ *
+ * User space interface, in /proc/net/tag_stat/:
+ *
+ *	ctrl	"t <fd> <tag> [<uid>]" tags socket <fd> of the writer, and
+ *		accounts it to <uid> (CAP_NET_ADMIN needed for other uids).
+ *		"u <fd>" drops the tag and returns the socket to its owner.
+ *	stats	one line per (iface, uid, tag) with rx/tx bytes and packets.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version
+ *	2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/capability.h>
+#include <linux/cred.h>
+#include <linux/file.h>
+#include <linux/init.h>
+#include <linux/jhash.h>
+#include <linux/kernel.h>
+#include <linux/net.h>
+#include <linux/notifier.h>
+#include <linux/proc_fs.h>
+#include <linux/rculist.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <asm/uaccess.h>
+
+#include <net/net_namespace.h>
+#include <net/tag_stat.h>
+
+#define TAG_STAT_HASH_BITS	8
+#define TAG_STAT_HASH_SIZE	(1 << TAG_STAT_HASH_BITS)
+#define TAG_STAT_MAX_TAGGED	4096
+#define TAG_STAT_MAX_UNTAGGED	1024
+#define TAG_STAT_UID_OTHER	((uid_t)-1)
+
+struct tag_stat_counters {
+	u64			bytes[TAG_STAT_DIRS];
+	u64			packets[TAG_STAT_DIRS];
+} ____cacheline_aligned_in_smp;
+
+struct tag_stat_entry {
+	struct hlist_node	node;
+	uid_t			uid;
+	u32			tag;
+	int			ifindex;	/* hint, 0 if unknown */
+	char			ifname[IFNAMSIZ];
+	struct tag_stat_counters counters[0];	/* nr_cpu_ids */
+};
+
+static struct hlist_head tag_stat_hash[TAG_STAT_HASH_SIZE];
+static DEFINE_SPINLOCK(tag_stat_lock);
+static unsigned int tag_stat_tagged;
+static unsigned int tag_stat_untagged;
+
+static inline unsigned int tag_stat_hashfn(uid_t uid, u32 tag,
+					   const char *ifname)
+{
+	u32 h = jhash(ifname, strnlen(ifname, IFNAMSIZ), 0);
+
+	return jhash_3words(uid, tag, h, 0) & (TAG_STAT_HASH_SIZE - 1);
+}
+
+static struct tag_stat_entry *tag_stat_find(uid_t uid, u32 tag,
+					    const char *ifname)
+{
+	struct hlist_head *head;
+	struct tag_stat_entry *e;
+	struct hlist_node *n;
+
+	head = &tag_stat_hash[tag_stat_hashfn(uid, tag, ifname)];
+	hlist_for_each_entry_rcu(e, n, head, node)
+		if (e->uid == uid && e->tag == tag &&
+		    !strncmp(e->ifname, ifname, IFNAMSIZ))
+			return e;
+	return NULL;
+}
+
+static inline bool tag_stat_full(uid_t uid, u32 tag)
+{
+	if (tag)
+		return tag_stat_tagged >= TAG_STAT_MAX_TAGGED;
+	return uid != TAG_STAT_UID_OTHER &&
+	       tag_stat_untagged >= TAG_STAT_MAX_UNTAGGED;
+}
+
+static struct tag_stat_entry *tag_stat_create(uid_t uid, u32 tag,
+					      const struct net_device *dev)
+{
+	struct tag_stat_entry *e;
+
+	spin_lock_bh(&tag_stat_lock);
+
+	/* Somebody may have beaten us to it, or the device is new */
+	e = tag_stat_find(uid, tag, dev->name);
+	if (e) {
+		e->ifindex = dev->ifindex;
+		goto out;
+	}
+
+	if (tag_stat_full(uid, tag))
+		goto out;
+
+	e = kzalloc(sizeof(*e) +
+		    nr_cpu_ids * sizeof(struct tag_stat_counters), GFP_ATOMIC);
+	if (!e)
+		goto out;
+
+	e->uid = uid;
+	e->tag = tag;
+	e->ifindex = dev->ifindex;
+	memcpy(e->ifname, dev->name, IFNAMSIZ);
+	hlist_add_head_rcu(&e->node,
+			   &tag_stat_hash[tag_stat_hashfn(uid, tag, e->ifname)]);
+	if (tag)
+		tag_stat_tagged++;
+	else
+		tag_stat_untagged++;
+out:
+	spin_unlock_bh(&tag_stat_lock);
+	return e;
+}
+
+static struct tag_stat_entry *tag_stat_get(uid_t uid, u32 tag,
+					   const struct net_device *dev)
+{
+	struct tag_stat_entry *e;
+
+	rcu_read_lock();
+	e = tag_stat_find(uid, tag, dev->name);
+	rcu_read_unlock();
+
+	/* Past the cap, don't take the lock for every packet */
+	if (e ? e->ifindex != dev->ifindex : !tag_stat_full(uid, tag))
+		e = tag_stat_create(uid, tag, dev);
+	if (!e && tag)
+		e = tag_stat_get(uid, 0, dev);
+	else if (!e && uid != TAG_STAT_UID_OTHER)
+		e = tag_stat_get(TAG_STAT_UID_OTHER, 0, dev);
+	return e;
+}
+
+/* Make sockets look their entry up again by name */
+static int tag_stat_netdev_event(struct notifier_block *nb,
+				 unsigned long event, void *ptr)
+{
+	struct net_device *dev = ptr;
+	struct tag_stat_entry *e;
+	struct hlist_node *n;
+	unsigned int h;
+
+	if (event != NETDEV_UNREGISTER && event != NETDEV_CHANGENAME)
+		return NOTIFY_DONE;
+
+	spin_lock_bh(&tag_stat_lock);
+	for (h = 0; h < TAG_STAT_HASH_SIZE; h++)
+		hlist_for_each_entry(e, n, &tag_stat_hash[h], node)
+			if (e->ifindex == dev->ifindex)
+				e->ifindex = 0;
+	spin_unlock_bh(&tag_stat_lock);
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block tag_stat_netdev_notifier = {
+	.notifier_call	= tag_stat_netdev_event,
+};
+
+/*
+ * Charge @len bytes to the socket's (uid, tag) on @dev.  A tag change
+ * racing with this may account one packet under a mixed key; that is
+ * not worth a lock on the packet path.
+ */
+void __tag_stat_account(struct sock *sk, const struct net_device *dev,
+			unsigned int len, int dir)
+{
+	struct tag_stat_entry *e = ACCESS_ONCE(sk->sk_tag_stat);
+	uid_t uid = sk->sk_tag_uid;
+	u32 tag = sk->sk_tag;
+	struct tag_stat_counters *c;
+
+	if (unlikely(!e || e->uid != uid || e->tag != tag ||
+		     e->ifindex != dev->ifindex)) {
+		e = tag_stat_get(uid, tag, dev);
+		if (!e)
+			return;
+		sk->sk_tag_stat = e;
+	}
+
+	/* TX may run in process context and be interrupted by RX/TX in BH */
+	local_bh_disable();
+	c = &e->counters[smp_processor_id()];
+	c->bytes[dir] += len;
+	c->packets[dir]++;
+	local_bh_enable();
+}
+
+static ssize_t tag_stat_ctrl_write(struct file *file, const char __user *ubuf,
+				   size_t count, loff_t *ppos)
+{
+	char buf[64];
+	char cmd;
+	int fd, n, err;
+	u32 tag = 0;
+	uid_t uid = current_fsuid();
+	struct socket *sock;
+	struct sock *sk;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	n = sscanf(buf, "%c %d %u %u", &cmd, &fd, &tag, &uid);
+	if (n < 2)
+		return -EINVAL;
+
+	switch (cmd) {
+	case 't':
+		if (n < 3)
+			return -EINVAL;
+		if (uid != current_fsuid() && !capable(CAP_NET_ADMIN))
+			return -EPERM;
+		break;
+	case 'u':
+		if (n != 2)
+			return -EINVAL;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	sock = sockfd_lookup(fd, &err);
+	if (!sock)
+		return err;
+	sk = sock->sk;
+
+	if (cmd == 'u') {
+		tag = 0;
+		uid = sock->file->f_cred->fsuid;
+	}
+
+	sk->sk_tag_uid = uid;
+	sk->sk_tag = tag;
+	sk->sk_tag_stat = NULL;
+
+	sockfd_put(sock);
+	return count;
+}
+
+static const struct file_operations tag_stat_ctrl_fops = {
+	.owner		= THIS_MODULE,
+	.write		= tag_stat_ctrl_write,
+};
+
+static struct tag_stat_entry *tag_stat_next(struct tag_stat_entry *e)
+{
+	unsigned int h;
+
+	if (e->node.next)
+		return hlist_entry(e->node.next, struct tag_stat_entry, node);
+
+	h = tag_stat_hashfn(e->uid, e->tag, e->ifname);
+	while (++h < TAG_STAT_HASH_SIZE)
+		if (!hlist_empty(&tag_stat_hash[h]))
+			return hlist_entry(tag_stat_hash[h].first,
+					   struct tag_stat_entry, node);
+	return NULL;
+}
+
+static struct tag_stat_entry *tag_stat_first(void)
+{
+	unsigned int h;
+
+	for (h = 0; h < TAG_STAT_HASH_SIZE; h++)
+		if (!hlist_empty(&tag_stat_hash[h]))
+			return hlist_entry(tag_stat_hash[h].first,
+					   struct tag_stat_entry, node);
+	return NULL;
+}
+
+static void *tag_stat_seq_start(struct seq_file *seq, loff_t *pos)
+	__acquires(tag_stat_lock)
+{
+	struct tag_stat_entry *e;
+	loff_t off = *pos;
+
+	spin_lock_bh(&tag_stat_lock);
+	if (!off)
+		return SEQ_START_TOKEN;
+
+	for (e = tag_stat_first(); e && --off; e = tag_stat_next(e))
+		;
+	return e;
+}
+
+static void *tag_stat_seq_next(struct seq_file *seq, void *v, loff_t *pos)
+{
+	++*pos;
+	if (v == SEQ_START_TOKEN)
+		return tag_stat_first();
+	return tag_stat_next(v);
+}
+
+static void tag_stat_seq_stop(struct seq_file *seq, void *v)
+	__releases(tag_stat_lock)
+{
+	spin_unlock_bh(&tag_stat_lock);
+}
+
+static int tag_stat_seq_show(struct seq_file *seq, void *v)
+{
+	struct tag_stat_entry *e = v;
+	u64 bytes[TAG_STAT_DIRS] = { 0 };
+	u64 packets[TAG_STAT_DIRS] = { 0 };
+	int cpu, dir;
+
+	if (v == SEQ_START_TOKEN) {
+		seq_puts(seq, "iface uid tag rx_bytes rx_packets "
+			 "tx_bytes tx_packets\n");
+		return 0;
+	}
+
+	for_each_possible_cpu(cpu)
+		for (dir = 0; dir < TAG_STAT_DIRS; dir++) {
+			bytes[dir] += e->counters[cpu].bytes[dir];
+			packets[dir] += e->counters[cpu].packets[dir];
+		}
+
+	seq_printf(seq, "%s %u 0x%08x %llu %llu %llu %llu\n",
+		   e->ifname, e->uid, e->tag,
+		   (unsigned long long)bytes[TAG_STAT_RX],
+		   (unsigned long long)packets[TAG_STAT_RX],
+		   (unsigned long long)bytes[TAG_STAT_TX],
+		   (unsigned long long)packets[TAG_STAT_TX]);
+	return 0;
+}
+
+static const struct seq_operations tag_stat_seq_ops = {
+	.start		= tag_stat_seq_start,
+	.next		= tag_stat_seq_next,
+	.stop		= tag_stat_seq_stop,
+	.show		= tag_stat_seq_show,
+};
+
+static int tag_stat_seq_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &tag_stat_seq_ops);
+}
+
+static const struct file_operations tag_stat_seq_fops = {
+	.owner		= THIS_MODULE,
+	.open		= tag_stat_seq_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int __init tag_stat_init(void)
+{
+	struct proc_dir_entry *dir;
+
+	dir = proc_mkdir("tag_stat", init_net.proc_net);
+	if (!dir)
+		goto err;
+	if (!proc_create("ctrl", S_IRUGO | S_IWUGO, dir, &tag_stat_ctrl_fops))
+		goto err_dir;
+	if (!proc_create("stats", S_IRUGO, dir, &tag_stat_seq_fops))
+		goto err_ctrl;
+	register_netdevice_notifier(&tag_stat_netdev_notifier);
+	return 0;
+
+err_ctrl:
+	remove_proc_entry("ctrl", dir);
+err_dir:
+	remove_proc_entry("tag_stat", init_net.proc_net);
+err:
+	printk(KERN_ERR "tag_stat: failed to create proc entries\n");
+	return -ENOMEM;
+}
+
+module_init(tag_stat_init);
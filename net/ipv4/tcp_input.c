@@ -92,6 +92,9 @@ int sysctl_tcp_nometrics_save __read_mostly;
 int sysctl_tcp_moderate_rcvbuf __read_mostly = 1;
 int sysctl_tcp_abc __read_mostly;
 
+/* Number of full sized segments to receive before an immediate ACK */
+int sysctl_tcp_delack_seg __read_mostly = 1;
+
 #define FLAG_DATA		0x01 /* Incoming frame contained data.		*/
 #define FLAG_WIN_UPDATE		0x02 /* Incoming ACK was a window update.	*/
 #define FLAG_DATA_ACKED		0x04 /* This ACK acknowledged new data.		*/
@@ -3564,6 +3567,26 @@ static int tcp_process_frto(struct sock *sk, int flag)
 	return 0;
 }
 
+/* Set sk_pacing_rate to 200 % of the current rate (mss * cwnd / srtt),
+ * for use by a pacing packet scheduler and by TCP small queues.
+ */
+static void tcp_update_pacing_rate(struct sock *sk)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	u64 rate;
+
+	rate = (u64)tp->mss_cache * 2 * (HZ << 3);
+	rate *= max(tp->snd_cwnd, tp->packets_out);
+
+	/* srtt is in jiffies << 3.  Below a couple of jiffies (or before
+	 * the first sample) it says little about the path, so be generous
+	 * and keep the rate computed for an 8x smaller srtt.
+	 */
+	if (tp->srtt > 8 + 2)
+		do_div(rate, tp->srtt);
+	sk->sk_pacing_rate = min_t(u64, rate, ~0U);
+}
+
 /* This routine deals with incoming acks, but not outgoing ones. */
 static int tcp_ack(struct sock *sk, struct sk_buff *skb, int flag)
 {
@@ -3667,6 +3690,7 @@ static int tcp_ack(struct sock *sk, struct sk_buff *skb, int flag)
 	if ((flag & FLAG_FORWARD_PROGRESS) || !(flag & FLAG_NOT_DUP))
 		dst_confirm(sk->sk_dst_cache);
 
+	tcp_update_pacing_rate(sk);
 	return 1;
 
 no_queue:
@@ -4844,8 +4868,9 @@ static void __tcp_ack_snd_check(struct sock *sk, int ofo_possible)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
 
-	    /* More than one full frame received... */
-	if (((tp->rcv_nxt - tp->rcv_wup) > inet_csk(sk)->icsk_ack.rcv_mss
+	    /* More than tcp_delack_seg full frames received... */
+	if (((tp->rcv_nxt - tp->rcv_wup) >
+	     inet_csk(sk)->icsk_ack.rcv_mss * sysctl_tcp_delack_seg
 	     /* ... and right edge of window advances far enough.
 	      * (tcp_recvmsg() will send ACK otherwise). Or...
 	      */
@@ -71,6 +71,7 @@
 #include <net/timewait_sock.h>
 #include <net/xfrm.h>
 #include <net/netdma.h>
+#include <net/tag_stat.h>
 
 #include <linux/inet.h>
 #include <linux/ipv6.h>
@@ -1614,6 +1615,8 @@ process:
 		goto discard_and_relse;
 	nf_reset(skb);
 
+	tag_stat_account(sk, skb->dev, ntohs(iph->tot_len), TAG_STAT_RX);
+
 	if (sk_filter(sk, skb))
 		goto discard_and_relse;
 
@@ -2473,6 +2476,7 @@ struct proto tcp_prot = {
 	.getsockopt		= tcp_getsockopt,
 	.recvmsg		= tcp_recvmsg,
 	.backlog_rcv		= tcp_v4_do_rcv,
+	.release_cb		= tcp_release_cb,
 	.hash			= inet_hash,
 	.unhash			= inet_unhash,
 	.get_port		= inet_csk_get_port,
@@ -104,6 +104,7 @@
 #include <net/route.h>
 #include <net/checksum.h>
 #include <net/xfrm.h>
+#include <net/tag_stat.h>
 #include <linux/uid_stat.h>
 #include "udp_impl.h"
 
@@ -1104,6 +1105,9 @@ int udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 		goto drop;
 	nf_reset(skb);
 
+	tag_stat_account(sk, skb->dev, ntohs(ip_hdr(skb)->tot_len),
+			 TAG_STAT_RX);
+
 	if (up->encap_type) {
 		/*
 		 * This is an encapsulation socket so pass the skb to
@@ -175,6 +175,7 @@ static void __nf_conntrack_helper_unregister(struct nf_conntrack_helper *me,
 	const struct hlist_node *n, *next;
 	const struct hlist_nulls_node *nn;
 	unsigned int i;
+	int cpu;
 
 	/* Get rid of expectations */
 	for (i = 0; i < nf_ct_expect_hsize; i++) {
@@ -189,12 +190,22 @@ static void __nf_conntrack_helper_unregister(struct nf_conntrack_helper *me,
 		}
 	}
 
-	/* Get rid of expecteds, set helpers to NULL. */
-	hlist_nulls_for_each_entry(h, nn, &net->ct.unconfirmed, hnnode)
-		unhelp(h, me);
+	/* Get rid of expecteds, set helpers to NULL.  Unconfirmed lists
+	 * first: a conntrack only ever moves from there into the hash. */
+	for_each_possible_cpu(cpu) {
+		struct ct_pcpu *pcpu = per_cpu_ptr(net->ct.pcpu_lists, cpu);
+
+		spin_lock(&pcpu->lock);
+		hlist_nulls_for_each_entry(h, nn, &pcpu->unconfirmed, hnnode)
+			unhelp(h, me);
+		spin_unlock(&pcpu->lock);
+	}
 	for (i = 0; i < net->ct.htable_size; i++) {
+		nf_conntrack_bucket_lock(&nf_conntrack_locks[i %
+							     CONNTRACK_LOCKS]);
 		hlist_nulls_for_each_entry(h, nn, &net->ct.hash[i], hnnode)
 			unhelp(h, me);
+		spin_unlock(&nf_conntrack_locks[i % CONNTRACK_LOCKS]);
 	}
 }
 
@@ -114,6 +114,7 @@
 #include <linux/mount.h>
 #include <net/checksum.h>
 #include <linux/security.h>
+#include <linux/splice.h>
 
 static struct hlist_head unix_socket_table[UNIX_HASH_SIZE + 1];
 static DEFINE_SPINLOCK(unix_table_lock);
@@ -167,6 +168,12 @@ static inline int unix_may_send(struct sock *sk, struct sock *osk)
 	return unix_peer(osk) == NULL || unix_our_peer(sk, osk);
 }
 
+/* Bytes of a stream skb not yet handed to the reader */
+static inline unsigned int unix_skb_len(const struct sk_buff *skb)
+{
+	return skb->len - UNIXCB(skb).consumed;
+}
+
 static inline int unix_recvq_full(struct sock const *sk)
 {
 	return skb_queue_len(&sk->sk_receive_queue) > sk->sk_max_ack_backlog;
@@ -360,6 +367,12 @@ static void unix_sock_destructor(struct sock *sk)
 	if (u->addr)
 		unix_release_addr(u->addr);
 
+	/* Left over from copying linear data out in splice_read */
+	if (sk->sk_sndmsg_page) {
+		put_page(sk->sk_sndmsg_page);
+		sk->sk_sndmsg_page = NULL;
+	}
+
 	atomic_dec(&unix_nr_socks);
 	local_bh_disable();
 	sock_prot_inuse_add(sock_net(sk), sk->sk_prot, -1);
@@ -501,6 +514,11 @@ static int unix_dgram_recvmsg(struct kiocb *, struct socket *,
 			      struct msghdr *, size_t, int);
 static int unix_dgram_connect(struct socket *, struct sockaddr *,
 			      int, int);
+static ssize_t unix_stream_sendpage(struct socket *, struct page *, int offset,
+				    size_t size, int flags);
+static ssize_t unix_stream_splice_read(struct socket *, loff_t *ppos,
+				       struct pipe_inode_info *, size_t size,
+				       unsigned int flags);
 static int unix_seqpacket_sendmsg(struct kiocb *, struct socket *,
 				  struct msghdr *, size_t);
 
@@ -522,7 +540,8 @@ static const struct proto_ops unix_stream_ops = {
 	.sendmsg =	unix_stream_sendmsg,
 	.recvmsg =	unix_stream_recvmsg,
 	.mmap =		sock_no_mmap,
-	.sendpage =	sock_no_sendpage,
+	.sendpage =	unix_stream_sendpage,
+	.splice_read =	unix_stream_splice_read,
 };
 
 static const struct proto_ops unix_dgram_ops = {
@@ -1611,6 +1630,74 @@ out_err:
 	return sent ? : err;
 }
 
+/*
+ *	Queue a page reference to the peer instead of copying the data,
+ *	so sendfile() and splice() into a stream socket stay zero-copy.
+ */
+
+static ssize_t unix_stream_sendpage(struct socket *sock, struct page *page,
+				    int offset, size_t size, int flags)
+{
+	struct sock *sk = sock->sk;
+	struct sock *other;
+	struct msghdr msg = { .msg_flags = flags };
+	struct scm_cookie scm;
+	struct sk_buff *skb;
+	int err;
+
+	if (flags & MSG_OOB)
+		return -EOPNOTSUPP;
+
+	err = scm_send(sock, &msg, &scm);
+	if (err < 0)
+		return err;
+
+	err = -ENOTCONN;
+	other = unix_peer(sk);
+	if (!other)
+		goto out_err;
+
+	if (sk->sk_shutdown & SEND_SHUTDOWN)
+		goto pipe_err;
+
+	skb = sock_alloc_send_skb(sk, 0, flags & MSG_DONTWAIT, &err);
+	if (skb == NULL)
+		goto out_err;
+
+	memcpy(UNIXCREDS(skb), &scm.creds, sizeof(struct ucred));
+
+	get_page(page);
+	skb_fill_page_desc(skb, 0, page, offset, size);
+	skb->len += size;
+	skb->data_len += size;
+	skb->truesize += size;
+	atomic_add(size, &sk->sk_wmem_alloc);
+
+	unix_state_lock(other);
+
+	if (sock_flag(other, SOCK_DEAD) ||
+	    (other->sk_shutdown & RCV_SHUTDOWN))
+		goto pipe_err_free;
+
+	skb_queue_tail(&other->sk_receive_queue, skb);
+	unix_state_unlock(other);
+	other->sk_data_ready(other, size);
+	scm_destroy(&scm);
+
+	return size;
+
+pipe_err_free:
+	unix_state_unlock(other);
+	kfree_skb(skb);
+pipe_err:
+	if (!(flags & MSG_NOSIGNAL))
+		send_sig(SIGPIPE, current, 0);
+	err = -EPIPE;
+out_err:
+	scm_destroy(&scm);
+	return err;
+}
+
 static int unix_seqpacket_sendmsg(struct kiocb *kiocb, struct socket *sock,
 				  struct msghdr *msg, size_t len)
 {
@@ -1856,8 +1943,9 @@ static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 			sunaddr = NULL;
 		}
 
-		chunk = min_t(unsigned int, skb->len, size);
-		if (memcpy_toiovec(msg->msg_iov, skb->data, chunk)) {
+		chunk = min_t(unsigned int, unix_skb_len(skb), size);
+		if (skb_copy_datagram_iovec(skb, UNIXCB(skb).consumed,
+					    msg->msg_iov, chunk)) {
 			skb_queue_head(&sk->sk_receive_queue, skb);
 			if (copied == 0)
 				copied = -EFAULT;
@@ -1868,13 +1956,13 @@ static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 
 		/* Mark read part of skb as used */
 		if (!(flags & MSG_PEEK)) {
-			skb_pull(skb, chunk);
+			UNIXCB(skb).consumed += chunk;
 
 			if (UNIXCB(skb).fp)
 				unix_detach_fds(siocb->scm, skb);
 
 			/* put the skb back if we didn't use it up.. */
-			if (skb->len) {
+			if (unix_skb_len(skb)) {
 				skb_queue_head(&sk->sk_receive_queue, skb);
 				break;
 			}
@@ -1901,6 +1989,111 @@ out:
 	return copied ? : err;
 }
 
+static int unix_splice_cb(struct sock *sk, struct pipe_inode_info *pipe,
+			  struct splice_pipe_desc *spd)
+{
+	/*
+	 * u->readlock stays held: unix_stream_sendpage() never takes it,
+	 * so there is no inversion against the pipe lock on the sendfile()
+	 * side, and it keeps the skb we are splicing from at the queue head.
+	 */
+	return splice_to_pipe(pipe, spd);
+}
+
+static ssize_t unix_stream_splice_read(struct socket *sock, loff_t *ppos,
+				       struct pipe_inode_info *pipe,
+				       size_t size, unsigned int flags)
+{
+	struct sock *sk = sock->sk;
+	struct unix_sock *u = unix_sk(sk);
+	struct scm_cookie scm;
+	ssize_t spliced = 0;
+	int err;
+	long timeo;
+
+	/*
+	 * We can't seek on a socket input
+	 */
+	if (unlikely(*ppos))
+		return -ESPIPE;
+
+	if (sk->sk_state != TCP_ESTABLISHED)
+		return -EINVAL;
+
+	timeo = sock_rcvtimeo(sk, (sock->file->f_flags & O_NONBLOCK) ||
+				  (flags & SPLICE_F_NONBLOCK));
+	memset(&scm, 0, sizeof(scm));
+	err = 0;
+
+	mutex_lock(&u->readlock);
+
+	while (size) {
+		int chunk;
+		struct sk_buff *skb;
+
+		unix_state_lock(sk);
+		skb = skb_peek(&sk->sk_receive_queue);
+		if (skb == NULL) {
+			if (spliced)
+				goto unlock;
+
+			err = sock_error(sk);
+			if (err)
+				goto unlock;
+			if (sk->sk_shutdown & RCV_SHUTDOWN)
+				goto unlock;
+
+			unix_state_unlock(sk);
+			err = -EAGAIN;
+			if (!timeo)
+				break;
+			mutex_unlock(&u->readlock);
+
+			timeo = unix_stream_data_wait(sk, timeo);
+
+			if (signal_pending(current)) {
+				err = sock_intr_errno(timeo);
+				goto out;
+			}
+			mutex_lock(&u->readlock);
+			continue;
+ unlock:
+			unix_state_unlock(sk);
+			break;
+		}
+		unix_state_unlock(sk);
+
+		chunk = min_t(unsigned int, unix_skb_len(skb), size);
+		chunk = skb_splice_bits(skb, sk, UNIXCB(skb).consumed, pipe,
+					chunk, flags, unix_splice_cb);
+		if (chunk <= 0) {
+			err = chunk;
+			break;
+		}
+		spliced += chunk;
+		size -= chunk;
+		UNIXCB(skb).consumed += chunk;
+
+		/* A pipe can't carry descriptors, they are dropped as by read() */
+		if (UNIXCB(skb).fp)
+			unix_detach_fds(&scm, skb);
+
+		if (unix_skb_len(skb))
+			break;
+
+		skb_unlink(skb, &sk->sk_receive_queue);
+		kfree_skb(skb);
+
+		if (scm.fp)
+			break;
+	}
+
+	mutex_unlock(&u->readlock);
+	scm_destroy(&scm);
+out:
+	return spliced ? : err;
+}
+
 static int unix_shutdown(struct socket *sock, int mode)
 {
 	struct sock *sk = sock->sk;
@@ -1967,7 +2160,7 @@ static int unix_ioctl(struct socket *sock, unsigned int cmd, unsigned long arg)
 			if (sk->sk_type == SOCK_STREAM ||
 			    sk->sk_type == SOCK_SEQPACKET) {
 				skb_queue_walk(&sk->sk_receive_queue, skb)
-					amount += skb->len;
+					amount += unix_skb_len(skb);
 			} else {
 				skb = skb_peek(&sk->sk_receive_queue);
 				if (skb)